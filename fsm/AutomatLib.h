@@ -47,8 +47,12 @@ class Automat {
   /**
      * @brief Registruje vstupní signál.
      * @param name Název vstupu.
+     * @param type Deklarovaný typ ("" = bez typu).
      */
-  void addInput(const std::string &name) { inputs.emplace_back(name); }
+  void addInput(const std::string &name, const std::string &type = "") {
+    inputs.emplace_back(name);
+    inputTypes.emplace_back(type);
+  }
 
   /**
      * @brief Registruje výstupní signál.
@@ -70,6 +74,9 @@ class Automat {
   /// Seznam vstupů
   std::vector<std::string> inputs;
 
+  /// Deklarované typy vstupů ve stejném pořadí ("" = bez typu)
+  std::vector<std::string> inputTypes;
+
   /// Seznam výstupů
   std::vector<std::string> outputs;
 
@@ -0,0 +1,497 @@
+#include "CompilerLib.h"
+
+#include <absl/container/flat_hash_set.h>
+#include <absl/log/log.h>
+#include <absl/strings/str_cat.h>
+#include <absl/strings/str_format.h>
+#include <absl/strings/str_join.h>
+
+#include <algorithm>
+#include <optional>
+#include <tuple>
+
+#include "DependencyLib.h"
+#include "Utils.h"
+
+namespace CompilerLib {
+
+int Compiler::ResolveDelay(
+    const std::string& delay,
+    const absl::flat_hash_map<std::string, std::string>& values) {
+  if (delay.empty())
+    return 0;
+  if (const auto it = values.find(delay); it != values.end()) {
+    if (const auto val = Utils::StringToNumeric<int>(it->second);
+        val.has_value())
+      return val.value();
+  }
+  return Utils::StringToNumeric<int>(delay).value_or(0);
+}
+
+CompiledAutomat Compiler::Compile(const AutomatLib::Automat& automat) const {
+  const auto& states = automat.states;
+  const auto& transitions = automat.transitions;
+  CompiledAutomat result;
+
+  if (states.empty()) {
+    LOG(ERROR) << "Automat has no states";
+    throw Utils::ProgramTermination();
+  }
+
+  result.stateNames.reserve(states.Size());
+  result.actionSources.reserve(states.Size());
+  for (auto it = states.cbegin(); it != states.cend(); ++it) {
+    const auto id = static_cast<uint32_t>(result.stateNames.size());
+    if (!result.stateIds.try_emplace(it->Name, id).second) {
+      LOG(ERROR) << absl::StrFormat("Duplicate state definition: %s", it->Name);
+      throw Utils::ProgramTermination();
+    }
+    result.stateNames.emplace_back(it->Name);
+    result.actionSources.emplace_back(it->Action);
+  }
+
+  result.signalNames.reserve(automat.inputs.size());
+  for (size_t i = 0; i < automat.inputs.size(); ++i) {
+    const auto& input = automat.inputs[i];
+    const auto id = static_cast<uint32_t>(result.signalNames.size());
+    if (!result.signalIds.try_emplace(input, id).second)
+      continue;
+    result.signalNames.emplace_back(input);
+    // Typ ověřil už parser, bez deklarace zůstává vstup řetězcem
+    const auto type = i < automat.inputTypes.size()
+                          ? SignalTypeOf(automat.inputTypes[i])
+                          : std::nullopt;
+    result.signalTypes.push_back(type.value_or(SignalType::Text));
+  }
+  result.outputNames.reserve(automat.outputs.size());
+  for (const auto& output : automat.outputs) {
+    const auto id = static_cast<uint32_t>(result.outputNames.size());
+    if (result.outputIds.try_emplace(output, id).second)
+      result.outputNames.emplace_back(output);
+  }
+
+  absl::flat_hash_map<std::string, std::string> values;
+  for (const auto& variable : automat.variables.Get()) {
+    values.try_emplace(variable.Name, variable.Value);
+    result.variables.emplace_back(variable);
+  }
+
+  // Transition::Id roste s pořadím v souboru, takže řazení podle id obnoví
+  // pořadí definice, které hash mapa v TransitionGroup neuchovává. Explicitní
+  // priorita má přednost; pořadí přechodů stavu je pořadím vyhodnocení.
+  std::vector<const Transition*> ordered;
+  ordered.reserve(transitions.Size());
+  for (auto it = transitions.cbegin(); it != transitions.cend(); ++it) {
+    ordered.emplace_back(&it->second);
+  }
+  std::sort(ordered.begin(), ordered.end(),
+            [](const Transition* a, const Transition* b) {
+              return std::tie(a->priority, a->Id) <
+                     std::tie(b->priority, b->Id);
+            });
+
+  Table table(result.StateCount());
+  for (const auto* tr : ordered) {
+    Arc arc{};
+    const auto from = result.StateId(tr->from);
+    arc.target = result.StateId(tr->to);
+    if (from == NoId || arc.target == NoId) {
+      LOG(ERROR) << absl::StrFormat("Transition %s -> %s uses undefined state",
+                                    tr->from, tr->to);
+      throw Utils::ProgramTermination();
+    }
+    if (!tr->input.empty()) {
+      arc.edge.signal = result.SignalId(tr->input);
+      if (arc.edge.signal == NoId) {
+        LOG(ERROR) << absl::StrFormat(
+            "Transition %s -> %s uses undeclared input %s", tr->from, tr->to,
+            tr->input);
+        throw Utils::ProgramTermination();
+      }
+    }
+    arc.edge.delay = ResolveDelay(tr->delay, values);
+    arc.edge.guarded = !tr->condition.empty();
+    arc.transition = tr->Id;
+    arc.guard = tr->condition;
+    arc.delay = tr->delay;
+    // Přechody stavu zůstávají v pořadí vyhodnocení
+    table[from].emplace_back(std::move(arc));
+  }
+
+  Prune(result, table);
+  result.IndexVariables();
+  Layout(result, table);
+  ReportOverlaps(result);
+  return result;
+}
+
+Compiler::Table Compiler::Expand(const CompiledAutomat& automat) {
+  Table table(automat.StateCount());
+  for (uint32_t s = 0; s < automat.StateCount(); ++s) {
+    const auto first = automat.FirstEdge(s);
+    const auto edges = automat.EdgesOf(s);
+    for (uint32_t i = 0; i < edges.size(); ++i) {
+      table[s].push_back(Arc{edges[i], automat.targets[automat.offsets[s] + i],
+                             automat.transitions[automat.offsets[s] + i],
+                             automat.guardSources[first + i]});
+    }
+  }
+  return table;
+}
+
+void Compiler::Layout(CompiledAutomat& automat, const Table& table) const {
+  automat.rows.clear();
+  automat.offsets.assign(1, 0);
+  automat.targets.clear();
+  automat.transitions.clear();
+  automat.rowOffsets.assign(1, 0);
+  automat.edges.clear();
+  automat.guardSources.clear();
+
+  // Řádek je určen vším kromě cílů a id přechodů
+  using Shape = std::vector<std::tuple<uint32_t, int, bool, std::string>>;
+  absl::flat_hash_map<Shape, uint32_t> shapes;
+  for (const auto& arcs : table) {
+    Shape shape;
+    shape.reserve(arcs.size());
+    for (const auto& arc : arcs) {
+      shape.emplace_back(arc.edge.signal, arc.edge.delay, arc.edge.guarded,
+                         arc.guard);
+    }
+    const auto [it, added] = shapes.try_emplace(
+        std::move(shape), static_cast<uint32_t>(automat.rowOffsets.size() - 1));
+    if (added) {
+      for (const auto& arc : arcs) {
+        automat.edges.emplace_back(arc.edge);
+        automat.guardSources.emplace_back(arc.guard);
+      }
+      automat.rowOffsets.emplace_back(
+          static_cast<uint32_t>(automat.edges.size()));
+    }
+    automat.rows.emplace_back(it->second);
+    for (const auto& arc : arcs) {
+      automat.targets.emplace_back(arc.target);
+      automat.transitions.emplace_back(arc.transition);
+    }
+    automat.offsets.emplace_back(static_cast<uint32_t>(automat.targets.size()));
+  }
+
+  BuildPlans(automat);
+}
+
+void Compiler::Minimize(CompiledAutomat& automat) const {
+  const auto n = automat.StateCount();
+  if (automat.actionSources.size() != n) {
+    LOG(WARNING) << "Minimization requires the text definition, skipped";
+    return;
+  }
+  const auto table = Expand(automat);
+
+  // Počáteční rozklad podle textu akce; stav s podmínkou tvoří vlastní blok
+  std::vector<uint32_t> block(n);
+  uint32_t count = 0;
+  {
+    absl::flat_hash_map<absl::string_view, uint32_t> byAction;
+    for (uint32_t s = 0; s < n; ++s) {
+      if (std::any_of(table[s].begin(), table[s].end(),
+                      [](const Arc& arc) { return arc.edge.guarded; }))
+        block[s] = count++;
+      else if (const auto [it, added] =
+                   byAction.try_emplace(automat.actionSources[s], count);
+               added)
+        block[s] = count++;
+      else
+        block[s] = it->second;
+    }
+  }
+
+  // Zjemňování bloků podle podpisu přechodů, dokud se rozklad mění. Blok
+  // dostane id podle svého prvního stavu, takže stav 0 zůstane v bloku 0.
+  std::vector<uint32_t> next(n);
+  absl::flat_hash_map<std::vector<uint32_t>, uint32_t> signatures;
+  while (true) {
+    signatures.clear();
+    for (uint32_t s = 0; s < n; ++s) {
+      std::vector<uint32_t> signature{block[s]};
+      for (const auto& arc : table[s]) {
+        signature.insert(signature.end(),
+                         {arc.edge.signal, static_cast<uint32_t>(arc.edge.delay),
+                          block[arc.target]});
+      }
+      next[s] = signatures
+                    .try_emplace(std::move(signature),
+                                 static_cast<uint32_t>(signatures.size()))
+                    .first->second;
+    }
+    block.swap(next);
+    if (signatures.size() == count)
+      break;
+    count = static_cast<uint32_t>(signatures.size());
+  }
+  if (count == n)
+    return;
+
+  std::vector<std::string> stateNames;
+  std::vector<std::string> actionSources;
+  Table merged;
+  for (uint32_t s = 0; s < n; ++s) {
+    if (block[s] != stateNames.size())
+      continue;  // stav sloučený do dřívějšího členu bloku
+    stateNames.emplace_back(automat.stateNames[s]);
+    actionSources.emplace_back(automat.actionSources[s]);
+    merged.emplace_back(table[s]);
+    for (auto& arc : merged.back()) {
+      arc.target = block[arc.target];
+    }
+  }
+
+  LOG(INFO) << absl::StrFormat("Minimized %d states to %d", n, count);
+  automat.stateNames = std::move(stateNames);
+  automat.actionSources = std::move(actionSources);
+  automat.stateIds.clear();
+  for (uint32_t s = 0; s < automat.StateCount(); ++s) {
+    automat.stateIds.try_emplace(automat.stateNames[s], s);
+  }
+  Layout(automat, merged);
+}
+
+void Compiler::Prune(CompiledAutomat& automat, Table& table) const {
+  // BFS z počátečního stavu přes všechny přechody bez ohledu na podmínky
+  std::vector<bool> reachable(automat.StateCount(), false);
+  std::vector<uint32_t> queue{0};
+  reachable[0] = true;
+  for (size_t i = 0; i < queue.size(); ++i) {
+    for (const auto& arc : table[queue[i]]) {
+      if (!reachable[arc.target]) {
+        reachable[arc.target] = true;
+        queue.emplace_back(arc.target);
+      }
+    }
+  }
+
+  if (queue.size() < automat.StateCount()) {
+    std::vector<uint32_t> remap(automat.StateCount(), NoId);
+    std::vector<std::string> stateNames;
+    std::vector<std::string> actionSources;
+    Table kept;
+    for (uint32_t s = 0; s < automat.StateCount(); ++s) {
+      if (!reachable[s]) {
+        LOG(WARNING) << absl::StrFormat(
+            "State %s is unreachable, removed with %d transitions",
+            automat.stateNames[s], table[s].size());
+        continue;
+      }
+      remap[s] = static_cast<uint32_t>(stateNames.size());
+      stateNames.emplace_back(std::move(automat.stateNames[s]));
+      actionSources.emplace_back(std::move(automat.actionSources[s]));
+      kept.emplace_back(std::move(table[s]));
+    }
+    for (auto& arcs : kept) {
+      for (auto& arc : arcs) {
+        arc.target = remap[arc.target];
+      }
+    }
+
+    automat.stateNames = std::move(stateNames);
+    automat.actionSources = std::move(actionSources);
+    table = std::move(kept);
+    automat.stateIds.clear();
+    for (uint32_t s = 0; s < automat.StateCount(); ++s) {
+      automat.stateIds.try_emplace(automat.stateNames[s], s);
+    }
+  }
+
+  // Proměnná je použitá, pokud ji zbylý chunk čte nebo přiřazuje nebo je
+  // zpožděním zbylého přechodu; chunk, který může sáhnout na libovolnou
+  // proměnnou, ponechá všechny
+  absl::flat_hash_set<std::string> used;
+  const auto collect = [&](const std::string& source) {
+    if (source.empty())
+      return true;
+    const auto deps = DependencyLib::Analyze(source, automat);
+    if (deps.writesAll)
+      return false;
+    used.insert(deps.reads.begin(), deps.reads.end());
+    used.insert(deps.writes.begin(), deps.writes.end());
+    return true;
+  };
+  if (!std::all_of(automat.actionSources.begin(), automat.actionSources.end(),
+                   collect))
+    return;
+  for (const auto& arcs : table) {
+    for (const auto& arc : arcs) {
+      if (!collect(arc.guard))
+        return;
+      if (!arc.delay.empty())
+        used.insert(arc.delay);
+    }
+  }
+  auto& variables = automat.variables;
+  variables.erase(
+      std::remove_if(variables.begin(), variables.end(),
+                     [&used](const Variable& variable) {
+                       if (used.contains(variable.Name))
+                         return false;
+                       LOG(WARNING) << absl::StrFormat(
+                           "Variable %s is never used, removed", variable.Name);
+                       return true;
+                     }),
+      variables.end());
+}
+
+void Compiler::ReportOverlaps(const CompiledAutomat& automat) const {
+  const auto& edges = automat.edges;
+  const auto report = [&](const uint32_t state, const uint32_t winner,
+                          const EdgeRange range, const uint32_t from) {
+    for (auto i = from; i < range.end; ++i) {
+      const auto shadowed = automat.order[i];
+      LOG(WARNING) << absl::StrFormat(
+          "State %s: transition %d (-> %s) is never taken, unconditional "
+          "transition %d (-> %s) always fires first",
+          automat.stateNames[state], automat.TransitionOf(state, shadowed),
+          automat.stateNames[automat.Target(state, shadowed)],
+          automat.TransitionOf(state, winner),
+          automat.stateNames[automat.Target(state, winner)]);
+    }
+  };
+  // Pozice prvního nepodmíněného přechodu v intervalu nebo range.end
+  const auto unconditional = [&](const EdgeRange range) {
+    auto i = range.begin;
+    while (i < range.end && edges[automat.order[i]].guarded) ++i;
+    return i;
+  };
+  // Časovače se zkouší po skupinách podle zpoždění, nepodmíněný přechod
+  // zastíní zbytek své skupiny i všechny pozdější
+  const auto timers = [&](const uint32_t state, const EdgeRange range) {
+    std::optional<uint32_t> winner;
+    automat.ForEachDelayGroup(range, [&](const Edge&, const EdgeRange group) {
+      if (winner.has_value()) {
+        report(state, winner.value(), group, group.begin);
+      } else if (const auto at = unconditional(group); at != group.end) {
+        winner = automat.order[at];
+        report(state, winner.value(), group, at + 1);
+      }
+    });
+    return winner;
+  };
+
+  for (uint32_t state = 0; state < automat.StateCount(); ++state) {
+    const auto& plan = automat.PlanOf(state);
+    if (const auto at = unconditional(plan.free); at != plan.free.end) {
+      // Volný nepodmíněný přechod se provede hned při vstupu do stavu
+      const auto winner = automat.order[at];
+      report(state, winner, plan.free, at + 1);
+      report(state, winner, plan.timers, plan.timers.begin);
+      for (auto b = plan.buckets.begin; b < plan.buckets.end; ++b) {
+        report(state, winner, automat.buckets[b].untimed,
+               automat.buckets[b].untimed.begin);
+        report(state, winner, automat.buckets[b].timed,
+               automat.buckets[b].timed.begin);
+      }
+      continue;
+    }
+
+    timers(state, plan.timers);
+    for (auto b = plan.buckets.begin; b < plan.buckets.end; ++b) {
+      const auto& bucket = automat.buckets[b];
+      if (const auto at = unconditional(bucket.untimed);
+          at != bucket.untimed.end) {
+        // Časované vstupní přechody se plánují jen když žádný nevyhoví
+        const auto winner = automat.order[at];
+        report(state, winner, bucket.untimed, at + 1);
+        report(state, winner, bucket.timed, bucket.timed.begin);
+      } else {
+        timers(state, bucket.timed);
+      }
+    }
+  }
+}
+
+void Compiler::BuildPlans(CompiledAutomat& automat) const {
+  const auto& edges = automat.edges;
+  const auto byDelay = [&edges](const uint32_t a, const uint32_t b) {
+    return edges[a].delay < edges[b].delay;
+  };
+  const auto bySignal = [&edges](const uint32_t a, const uint32_t b) {
+    return edges[a].signal < edges[b].signal;
+  };
+  const auto cursor = [&automat] {
+    return static_cast<uint32_t>(automat.order.size());
+  };
+
+  automat.plans.assign(automat.rowOffsets.size() - 1, StatePlan{});
+  automat.order.clear();
+  automat.order.reserve(edges.size());
+  automat.buckets.clear();
+
+  std::vector<uint32_t> inputEdges;
+  std::vector<std::string> names;
+  for (uint32_t row = 0; row < automat.RowCount(); ++row) {
+    auto& plan = automat.plans[row];
+    const auto first = automat.rowOffsets[row];
+    const auto last = automat.rowOffsets[row + 1];
+
+    plan.free.begin = cursor();
+    for (auto e = first; e < last; ++e) {
+      if (!edges[e].HasInput() && !edges[e].HasDelay())
+        automat.order.emplace_back(e);
+    }
+    plan.free.end = cursor();
+
+    plan.timers.begin = cursor();
+    for (auto e = first; e < last; ++e) {
+      if (!edges[e].HasInput() && edges[e].HasDelay())
+        automat.order.emplace_back(e);
+    }
+    plan.timers.end = cursor();
+    std::stable_sort(automat.order.begin() + plan.timers.begin,
+                     automat.order.end(), byDelay);
+
+    inputEdges.clear();
+    for (auto e = first; e < last; ++e) {
+      if (edges[e].HasInput())
+        inputEdges.emplace_back(e);
+    }
+    std::stable_sort(inputEdges.begin(), inputEdges.end(), bySignal);
+
+    names.clear();
+    plan.buckets.begin = static_cast<uint32_t>(automat.buckets.size());
+    for (size_t i = 0; i < inputEdges.size();) {
+      InputBucket bucket{};
+      bucket.signal = edges[inputEdges[i]].signal;
+      auto j = i;
+      while (j < inputEdges.size() &&
+             edges[inputEdges[j]].signal == bucket.signal)
+        ++j;
+
+      bucket.untimed.begin = cursor();
+      for (auto k = i; k < j; ++k) {
+        if (!edges[inputEdges[k]].HasDelay())
+          automat.order.emplace_back(inputEdges[k]);
+      }
+      bucket.untimed.end = cursor();
+
+      bucket.timed.begin = cursor();
+      for (auto k = i; k < j; ++k) {
+        if (edges[inputEdges[k]].HasDelay())
+          automat.order.emplace_back(inputEdges[k]);
+      }
+      bucket.timed.end = cursor();
+      std::stable_sort(automat.order.begin() + bucket.timed.begin,
+                       automat.order.end(), byDelay);
+
+      plan.inputs |= !bucket.untimed.empty();
+      plan.timedInputs |= !bucket.timed.empty();
+      names.emplace_back(automat.signalNames[bucket.signal]);
+      automat.buckets.emplace_back(bucket);
+      i = j;
+    }
+    plan.buckets.end = static_cast<uint32_t>(automat.buckets.size());
+
+    std::sort(names.begin(), names.end());
+    plan.requestInputs =
+        absl::StrCat("REQUEST_INPUTS: ", absl::StrJoin(names, ", "));
+  }
+}
+
+}  // namespace CompilerLib
@@ -0,0 +1,99 @@
+/**
+ * @file   CompilerLib.h
+ * @brief  Deklaruje překladač automatu do indexované běhové reprezentace.
+ * @details
+ * Compiler převádí rozparsované stavy, vstupy a přechody na
+ * CompiledAutomat: stavy a signály dostanou husté id a přechody jsou uloženy
+ * v souvislých CSR polích, aby interpret nemusel při každém kroku hledat podle
+ * jmen a kopírovat skupiny přechodů.
+ * @date   2025-05-11
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "AutomatLib.h"
+#include "types/all_types.h"
+
+namespace CompilerLib {
+using namespace types;
+
+/**
+ * @class Compiler
+ * @brief Sestavuje CompiledAutomat z modelu automatu.
+ */
+class Compiler {
+ public:
+  /**
+   * @brief Přeloží automat do indexované podoby.
+   * @param automat Rozparsovaný automat; první stav je počáteční.
+   * @return Přeložený automat.
+   */
+  [[nodiscard]] CompiledAutomat Compile(
+      const AutomatLib::Automat& automat) const;
+
+  /**
+   * @brief Sloučí ekvivalentní stavy bez podmínek (volba --minimize).
+   * @details Stavy jsou ekvivalentní, pokud mají stejný text akce a jejich
+   * přechody v pořadí vyhodnocení mají stejný vstup, zpoždění a ekvivalentní
+   * cíl. Stav s podmíněným přechodem zůstává samostatný. Sloučený stav nese
+   * jméno svého prvního člena, počáteční stav zůstává s id 0.
+   * @param automat Přeložený automat se zdrojovými texty akcí.
+   */
+  void Minimize(CompiledAutomat& automat) const;
+
+ private:
+  /// Přechod stavu před sloučením do sdílených řádků
+  struct Arc {
+    Edge edge{};
+    uint32_t target = NoId;
+    uint32_t transition = 0;
+    std::string guard{};
+    std::string delay{}; /**< Zpoždění ze zdroje (číslo nebo jméno proměnné) */
+  };
+
+  /// Přechody po stavech v pořadí vyhodnocení
+  using Table = std::vector<std::vector<Arc>>;
+
+  /**
+   * @brief Převede zpoždění přechodu (číslo nebo jméno proměnné) na ms.
+   * @return Zpoždění v ms nebo 0, pokud jej nelze určit.
+   */
+  static int ResolveDelay(
+      const std::string& delay,
+      const absl::flat_hash_map<std::string, std::string>& values);
+
+  /**
+   * @brief Odstraní stavy nedosažitelné z počátečního stavu, jejich přechody
+   * a proměnné, které žádná akce, podmínka ani zpoždění přechodu nepoužívá.
+   * @details Podmínky se považují za splnitelné, odstraněné prvky se hlásí
+   * jako varování.
+   */
+  void Prune(CompiledAutomat& automat, Table& table) const;
+
+  /**
+   * @brief Rozbalí sdílené řádky zpět na přechody po stavech.
+   */
+  [[nodiscard]] static Table Expand(const CompiledAutomat& automat);
+
+  /**
+   * @brief Uloží přechody do sdílených řádků a sestaví jejich plány.
+   * @details Stavy se stejnou posloupností vstupů, zpoždění a podmínek
+   * sdílejí řádek; pro každý stav zůstanou jen cíle přechodů.
+   */
+  void Layout(CompiledAutomat& automat, const Table& table) const;
+
+  /**
+   * @brief Sestaví pro každý řádek plán výběru přechodů (StatePlan).
+   */
+  void BuildPlans(CompiledAutomat& automat) const;
+
+  /**
+   * @brief Varuje před přechody, které zastíní dřívější nepodmíněný přechod.
+   */
+  void ReportOverlaps(const CompiledAutomat& automat) const;
+};
+
+}  // namespace CompilerLib
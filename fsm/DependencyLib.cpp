@@ -0,0 +1,353 @@
+#include "DependencyLib.h"
+
+#include <absl/container/flat_hash_set.h>
+#include <absl/strings/string_view.h>
+
+#include <algorithm>
+#include <cctype>
+
+namespace DependencyLib {
+
+namespace {
+
+const absl::flat_hash_set<absl::string_view> Keywords = {
+    "and",   "break", "do",     "else", "elseif", "end",   "false", "for",
+    "function", "goto", "if",   "in",   "local",  "nil",   "not",   "or",
+    "repeat", "return", "then", "true", "until",  "while"};
+
+/// Funkce bez vedlejších efektů, výsledek závisí jen na argumentech
+const absl::flat_hash_set<absl::string_view> PureFunctions = {
+    "tonumber", "tostring", "type"};
+
+/// Funkce, které nezapisují proměnné, ale výsledek nelze pamatovat
+const absl::flat_hash_set<absl::string_view> ImpureFunctions = {
+    "elapsed", "output", "print"};
+
+/// Knihovny, jejichž funkce nezapisují proměnné
+const absl::flat_hash_set<absl::string_view> PureLibraries = {"math",
+                                                              "string"};
+
+/// Funkce čisté knihovny, které vrací pokaždé jiný výsledek
+const absl::flat_hash_set<absl::string_view> ImpureMembers = {"random",
+                                                              "randomseed"};
+
+/// Jména zpřístupňující prostředí jinak než přes globální proměnné
+const absl::flat_hash_set<absl::string_view> Escapes = {
+    "_ENV", "_G", "rawset", "rawget", "setmetatable", "getmetatable",
+    "load", "dofile", "require", "debug"};
+
+struct Token {
+  enum Kind { Name, String, Number, Symbol };
+  Kind kind;
+  std::string text;
+  bool literal = true; /**< Řetězec bez escape sekvencí */
+};
+
+bool IsNameChar(const char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+/// Délka otevírací dlouhé závorky na pozici i, jinak 0
+size_t LongBracket(const std::string& s, const size_t i) {
+  if (i >= s.size() || s[i] != '[')
+    return 0;
+  auto j = i + 1;
+  while (j < s.size() && s[j] == '=') ++j;
+  return j < s.size() && s[j] == '[' ? j - i + 1 : 0;
+}
+
+std::vector<Token> Tokenize(const std::string& s) {
+  std::vector<Token> tokens;
+  size_t i = 0;
+  while (i < s.size()) {
+    const char c = s[i];
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++i;
+    } else if (c == '-' && i + 1 < s.size() && s[i + 1] == '-') {
+      if (const auto open = LongBracket(s, i + 2); open != 0) {
+        const auto close = "]" + std::string(open - 2, '=') + "]";
+        const auto end = s.find(close, i + 2 + open);
+        i = end == std::string::npos ? s.size() : end + close.size();
+      } else {
+        i = std::min(s.find('\n', i), s.size());
+      }
+    } else if (const auto open = LongBracket(s, i); open != 0) {
+      const auto close = "]" + std::string(open - 2, '=') + "]";
+      const auto end = std::min(s.find(close, i + open), s.size());
+      tokens.push_back({Token::String, s.substr(i + open, end - i - open)});
+      i = std::min(end + close.size(), s.size());
+    } else if (c == '"' || c == '\'') {
+      Token token{Token::String, {}};
+      for (++i; i < s.size() && s[i] != c; ++i) {
+        if (s[i] == '\\') {
+          token.literal = false;
+          ++i;
+        }
+        if (i < s.size())
+          token.text += s[i];
+      }
+      tokens.push_back(std::move(token));
+      ++i;
+    } else if (std::isdigit(static_cast<unsigned char>(c)) ||
+               (c == '.' && i + 1 < s.size() &&
+                std::isdigit(static_cast<unsigned char>(s[i + 1])))) {
+      const auto begin = i;
+      for (++i; i < s.size(); ++i) {
+        const char e = static_cast<char>(std::tolower(s[i - 1]));
+        if (!IsNameChar(s[i]) && s[i] != '.' &&
+            !((s[i] == '+' || s[i] == '-') && (e == 'e' || e == 'p')))
+          break;
+      }
+      tokens.push_back({Token::Number, s.substr(begin, i - begin)});
+    } else if (IsNameChar(c)) {
+      const auto begin = i;
+      while (i < s.size() && IsNameChar(s[i])) ++i;
+      tokens.push_back({Token::Name, s.substr(begin, i - begin)});
+    } else {
+      static constexpr absl::string_view Long[] = {
+          "...", "==", "~=", "<=", ">=", "..", "::", "//", "<<", ">>"};
+      size_t length = 1;
+      for (const auto symbol : Long) {
+        if (absl::string_view(s).substr(i, symbol.size()) == symbol) {
+          length = symbol.size();
+          break;
+        }
+      }
+      tokens.push_back({Token::Symbol, s.substr(i, length)});
+      i += length;
+    }
+  }
+  return tokens;
+}
+
+/**
+ * @class Analyzer
+ * @brief Jeden průchod tokeny chunku.
+ */
+class Analyzer {
+ public:
+  Analyzer(std::vector<Token> tokens, const CompiledAutomat& automat)
+      : tokens(std::move(tokens)), automat(automat) {}
+
+  Dependencies Run() {
+    for (size_t i = 0; i < tokens.size(); ++i) {
+      const auto& token = tokens[i];
+      if (token.kind == Token::Symbol) {
+        if (token.text == "{") {
+          ++braces;
+        } else if (token.text == "}") {
+          --braces;
+        } else if (token.text == "=") {
+          Assignment(i);
+        } else if (token.text == "...") {
+          Escape();
+        } else if ((token.text == ")" || token.text == "]") && IsCall(i + 1)) {
+          // Volání výsledku výrazu, funkci nelze určit
+          Escape();
+        }
+      } else if (token.kind == Token::Name) {
+        if (token.text == "function") {
+          i = Function(i);
+        } else if (!Keywords.contains(token.text) && !IsMember(i)) {
+          i = Name(i);
+        }
+      }
+    }
+
+    for (auto* names : {&deps.reads, &deps.writes}) {
+      std::sort(names->begin(), names->end());
+      names->erase(std::unique(names->begin(), names->end()), names->end());
+    }
+    std::sort(deps.inputs.begin(), deps.inputs.end());
+    deps.inputs.erase(std::unique(deps.inputs.begin(), deps.inputs.end()),
+                      deps.inputs.end());
+    return deps;
+  }
+
+ private:
+  [[nodiscard]] bool Is(const size_t i, const absl::string_view symbol) const {
+    return i < tokens.size() && tokens[i].kind == Token::Symbol &&
+           tokens[i].text == symbol;
+  }
+
+  [[nodiscard]] bool IsName(const size_t i) const {
+    return i < tokens.size() && tokens[i].kind == Token::Name &&
+           !Keywords.contains(tokens[i].text);
+  }
+
+  [[nodiscard]] bool IsLiteral(const size_t i) const {
+    return i < tokens.size() && tokens[i].kind == Token::String &&
+           tokens[i].literal;
+  }
+
+  /// Token na pozici i začíná argumenty volání
+  [[nodiscard]] bool IsCall(const size_t i) const {
+    return Is(i, "(") || Is(i, "{") ||
+           (i < tokens.size() && tokens[i].kind == Token::String);
+  }
+
+  /// Jméno je pole nebo metoda (a.b, a:b), ne globální proměnná
+  [[nodiscard]] bool IsMember(const size_t i) const {
+    return i > 0 && (Is(i - 1, ".") || Is(i - 1, ":"));
+  }
+
+  /// Chunk může zapsat cokoliv a jeho výsledek nelze pamatovat
+  void Escape() {
+    deps.pure = false;
+    deps.writesAll = true;
+  }
+
+  void Input(const absl::string_view name) {
+    // Nedeklarovaný vstup je vždy nil, závislost nevzniká
+    if (const auto id = automat.SignalId(name); id != NoId)
+      deps.inputs.push_back(id);
+  }
+
+  /// Zpracuje jméno na pozici i, vrací poslední zpracovaný token
+  size_t Name(const size_t i) {
+    const auto& name = tokens[i].text;
+    if (Escapes.contains(name)) {
+      Escape();
+      return i;
+    }
+    if (name == "valueof" || name == "defined") {
+      if (Is(i + 1, "(") && IsLiteral(i + 2) && Is(i + 3, ")")) {
+        Input(tokens[i + 2].text);
+        return i + 3;
+      }
+      deps.allInputs = true;
+      return i;
+    }
+    if (name == "Inputs") {
+      if (Is(i + 1, ".") && IsName(i + 2)) {
+        Input(tokens[i + 2].text);
+        return i + 2;
+      }
+      if (Is(i + 1, "[") && IsLiteral(i + 2) && Is(i + 3, "]")) {
+        Input(tokens[i + 2].text);
+        return i + 3;
+      }
+      deps.allInputs = true;
+      return i;
+    }
+    if (name == "Outputs") {
+      // Výstupy se nesledují
+      deps.pure = false;
+      return i;
+    }
+    if (PureLibraries.contains(name) && Is(i + 1, ".") && IsName(i + 2)) {
+      if (ImpureMembers.contains(tokens[i + 2].text))
+        deps.pure = false;
+      return i + 2;
+    }
+
+    if (IsCall(i + 1)) {
+      if (ImpureFunctions.contains(name))
+        deps.pure = false;
+      else if (!PureFunctions.contains(name))
+        Escape();
+      return i;
+    }
+
+    // Proměnná; volání jejího pole (a.b()) může zapsat cokoliv
+    auto j = i + 1;
+    while ((Is(j, ".") || Is(j, ":")) && IsName(j + 1)) j += 2;
+    if (j != i + 1 && IsCall(j))
+      Escape();
+    deps.reads.push_back(name);
+    return i;
+  }
+
+  /// function jméno(...) přiřadí globální proměnnou; vrací token jména
+  size_t Function(const size_t i) {
+    if (!IsName(i + 1))
+      return i;
+    deps.pure = false;
+    if (Is(i + 2, ".") || Is(i + 2, ":"))
+      Escape();
+    else if (i == 0 || !(tokens[i - 1].kind == Token::Name &&
+                         tokens[i - 1].text == "local"))
+      deps.writes.push_back(tokens[i + 1].text);
+    return i + 1;
+  }
+
+  /// Najde cíle přiřazení před '=' na pozici i
+  void Assignment(const size_t i) {
+    if (braces > 0)
+      return;  // pole konstruktoru tabulky
+
+    std::vector<std::pair<size_t, bool>> targets;
+    auto end = i;
+    while (true) {
+      if (end == 0) {
+        Escape();
+        return;
+      }
+      auto k = end - 1;
+      bool suffix = false;
+      while (true) {
+        if (Is(k, "]")) {
+          int depth = 0;
+          while (true) {
+            if (Is(k, "]"))
+              ++depth;
+            else if (Is(k, "[") && --depth == 0)
+              break;
+            if (k == 0) {
+              Escape();
+              return;
+            }
+            --k;
+          }
+        } else if (!(IsName(k) && IsMember(k))) {
+          break;
+        }
+        if (k == 0) {
+          Escape();
+          return;
+        }
+        k -= IsName(k) ? 2 : 1;
+        suffix = true;
+      }
+      if (!IsName(k)) {
+        Escape();
+        return;
+      }
+      targets.emplace_back(k, suffix);
+      if (k > 0 && Is(k - 1, ",")) {
+        end = k - 1;
+        continue;
+      }
+      // local a, b = ... jen deklaruje lokální proměnné
+      if (k > 0 && tokens[k - 1].kind == Token::Name &&
+          tokens[k - 1].text == "local")
+        return;
+      break;
+    }
+
+    deps.pure = false;
+    for (const auto& [k, suffix] : targets) {
+      const auto& name = tokens[k].text;
+      if (name == "Inputs" || name == "Outputs")
+        continue;  // zápis přes proxy sleduje runtime
+      if (suffix || Escapes.contains(name))
+        Escape();  // pole tabulky může sdílet jiná proměnná
+      else
+        deps.writes.push_back(name);
+    }
+  }
+
+  std::vector<Token> tokens;
+  const CompiledAutomat& automat;
+  Dependencies deps;
+  int braces = 0;
+};
+
+}  // namespace
+
+Dependencies Analyze(const std::string& source,
+                     const CompiledAutomat& automat) {
+  return Analyzer(Tokenize(source), automat).Run();
+}
+
+}  // namespace DependencyLib
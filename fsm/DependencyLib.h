@@ -0,0 +1,47 @@
+/**
+ * @file   DependencyLib.h
+ * @brief  Deklaruje statickou analýzu toho, co Lua chunk čte a zapisuje.
+ * @details
+ * Analýza projde tokeny zdroje podmínky nebo akce a zjistí, které vstupy
+ * (valueof, defined, Inputs) a globální proměnné čte a které proměnné
+ * přiřazuje. Runtime podle toho pamatuje výsledky podmínek a zneplatní je
+ * jen při zápisu do závislosti. Analýza je konzervativní: volání neznámé
+ * funkce, zápis do pole tabulky nebo práce s _ENV/_G znamená, že chunk může
+ * zapsat cokoliv, a podmínka s takovým chunkem se nepamatuje.
+ * @date   2025-05-11
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types/all_types.h"
+
+namespace DependencyLib {
+using namespace types;
+
+/**
+ * @struct Dependencies
+ * @brief Výsledek analýzy jednoho chunku.
+ */
+struct Dependencies {
+  bool pure = true;       /**< Výsledek závisí jen na čtených vstupech a proměnných */
+  bool allInputs = false; /**< Čte vstup, jehož jméno není konstanta */
+  bool writesAll = false; /**< Může zapsat libovolnou proměnnou */
+  std::vector<uint32_t> inputs{};     /**< Id čtených vstupů */
+  std::vector<std::string> reads{};   /**< Čtené globální proměnné */
+  std::vector<std::string> writes{};  /**< Přiřazené globální proměnné */
+
+  /// Podmínku lze pamatovat: nic nezapisuje a nezávisí na čase ani okolí
+  [[nodiscard]] bool Memoizable() const {
+    return pure && !writesAll && writes.empty();
+  }
+};
+
+/**
+ * @brief Analyzuje zdrojový text podmínky nebo akce.
+ */
+Dependencies Analyze(const std::string& source, const CompiledAutomat& automat);
+
+}  // namespace DependencyLib
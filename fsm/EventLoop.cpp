@@ -0,0 +1,192 @@
+#include "EventLoop.h"
+
+#ifdef __linux__
+
+#include <absl/log/log.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "ProtocolLib.h"
+#include "Utils.h"
+
+namespace EventLoop {
+
+Reactor::Reactor(LineParser parser) : parse(std::move(parser)) {
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  drainFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (epollFd < 0 || timerFd < 0 || wakeFd < 0 || stopFd < 0 || drainFd < 0) {
+    LOG(ERROR) << "Failed to create event loop descriptors: "
+               << std::strerror(errno);
+    throw Utils::ProgramTermination();
+  }
+
+  for (const auto fd : {timerFd, wakeFd}) {
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      LOG(ERROR) << "epoll_ctl failed: " << std::strerror(errno);
+      throw Utils::ProgramTermination();
+    }
+  }
+
+  reader = std::thread([this] { ReadLoop(); });
+}
+
+Reactor::~Reactor() {
+  if (reader.joinable()) {
+    stopping.store(true, std::memory_order_release);
+    const uint64_t one = 1;
+    [[maybe_unused]] const auto r = write(stopFd, &one, sizeof one);
+    reader.join();
+  }
+  for (const auto fd : {epollFd, timerFd, wakeFd, stopFd, drainFd}) {
+    if (fd >= 0)
+      close(fd);
+  }
+}
+
+Reactor::Ready Reactor::Wait() {
+  epoll_event events[2];
+  int n;
+  do {
+    n = epoll_wait(epollFd, events, 2, -1);
+  } while (n < 0 && errno == EINTR);
+
+  if (n < 0) {
+    LOG(ERROR) << "epoll_wait failed: " << std::strerror(errno);
+    throw Utils::ProgramTermination();
+  }
+
+  Ready ready;
+  for (int i = 0; i < n; ++i) {
+    uint64_t count = 0;
+    // Přečtení vynuluje čítač, jinak by epoll hlásil připravenost znovu
+    [[maybe_unused]] const auto r =
+        read(events[i].data.fd, &count, sizeof count);
+    if (events[i].data.fd == timerFd)
+      ready.timer = true;
+    else
+      ready.input = true;
+  }
+  return ready;
+}
+
+bool Reactor::Pop(StdinEvent& event) {
+  if (!queue.TryPop(event))
+    return false;
+  // Párový fence s Push: buď Push uvidí uvolněné místo, nebo Pop jeho čekání
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (producerWaiting.load(std::memory_order_relaxed) &&
+      producerWaiting.exchange(false)) {
+    const uint64_t one = 1;
+    [[maybe_unused]] const auto r = write(drainFd, &one, sizeof one);
+  }
+  return true;
+}
+
+void Reactor::ArmTimer(const std::chrono::steady_clock::time_point deadline) {
+  // steady_clock na Linuxu odpovídá CLOCK_MONOTONIC
+  const auto since = deadline.time_since_epoch();
+  const auto sec = std::chrono::duration_cast<std::chrono::seconds>(since);
+  const auto nsec =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(since - sec);
+
+  itimerspec spec{};
+  spec.it_value.tv_sec = static_cast<time_t>(sec.count());
+  spec.it_value.tv_nsec = static_cast<long>(nsec.count());
+  if (spec.it_value.tv_sec <= 0 && spec.it_value.tv_nsec <= 0)
+    spec.it_value.tv_nsec = 1;  // nulová hodnota by časovač zrušila
+
+  if (timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+    LOG(ERROR) << "timerfd_settime failed: " << std::strerror(errno);
+    throw Utils::ProgramTermination();
+  }
+}
+
+void Reactor::DisarmTimer() {
+  const itimerspec spec{};
+  timerfd_settime(timerFd, 0, &spec, nullptr);
+}
+
+void Reactor::Wake() {
+  const uint64_t one = 1;
+  [[maybe_unused]] const auto r = write(wakeFd, &one, sizeof one);
+}
+
+void Reactor::Push(StdinEvent&& event) {
+  // Plná fronta: stdin se nečte, dokud runtime neuvolní místo (bez točení)
+  while (!queue.TryPush(std::move(event))) {
+    producerWaiting.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (queue.TryPush(std::move(event))) {
+      producerWaiting.store(false);
+      break;
+    }
+
+    pollfd fds[2]{};
+    fds[0].fd = drainFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stopFd;
+    fds[1].events = POLLIN;
+    if (poll(fds, 2, -1) < 0 && errno != EINTR)
+      return;
+    if (fds[1].revents != 0)
+      return;
+    uint64_t count = 0;
+    [[maybe_unused]] const auto r = read(drainFd, &count, sizeof count);
+  }
+  Wake();
+}
+
+void Reactor::ReadLoop() {
+  pollfd fds[2]{};
+  fds[0].fd = STDIN_FILENO;
+  fds[0].events = POLLIN;
+  fds[1].fd = stopFd;
+  fds[1].events = POLLIN;
+
+  ProtocolLib::LineReader input(STDIN_FILENO);
+  absl::string_view line;
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    if (fds[1].revents != 0)
+      return;
+
+    const auto n = input.Fill();
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      if (!input.Rest().empty())
+        Push(parse(input.Rest()));
+      break;
+    }
+
+    // Řádky se rozebírají přímo v bufferu, bez kopie
+    while (input.Next(line)) {
+      Push(parse(line));
+    }
+  }
+
+  StdinEvent closed;
+  closed.kind = StdinEvent::Closed;
+  Push(std::move(closed));
+}
+
+}  // namespace EventLoop
+
+#endif
@@ -0,0 +1,108 @@
+/**
+ * @file   EventLoop.h
+ * @brief  Deklaruje reaktor pro událostmi řízený běh automatu (epoll + timerfd).
+ * @details
+ * Reactor multiplexuje vstupy ze stdin a časovače přechodů v jednom epoll
+ * volání. Samostatné čtecí vlákno rozebírá řádky stdin a předává je hlavnímu
+ * vláknu přes lock-free SPSC frontu, časovač je jeden timerfd nastavovaný na
+ * nejbližší termín. Vstup tak může přijít i během čekání na zpoždění.
+ * @date   2025-05-11
+ */
+#pragma once
+
+#include <absl/strings/string_view.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "SpscQueue.h"
+#include "types/compiled.h"
+
+namespace EventLoop {
+
+/**
+ * @struct StdinEvent
+ * @brief Výsledek rozboru jednoho řádku ze stdin.
+ */
+struct StdinEvent {
+  /// Druh řádku
+  enum Kind { Ignored, Input, Stop, Closed, Error };
+
+  Kind kind = Ignored;
+  types::InputFrame inputs{}; /**< Hodnoty vstupů řádku pro Input. */
+};
+
+#ifdef __linux__
+
+/**
+ * @class Reactor
+ * @brief Čeká současně na vstupy ze stdin a na vypršení časovače.
+ */
+class Reactor {
+ public:
+  /// Rozbor řádku; volá se ze čtecího vlákna, nesmí sahat na Lua stav
+  /// (řádek ukazuje do bufferu čtecího vlákna a platí jen během volání)
+  using LineParser = std::function<StdinEvent(absl::string_view)>;
+
+  /// Co je po návratu z Wait připraveno ke zpracování
+  struct Ready {
+    bool input = false;
+    bool timer = false;
+  };
+
+  explicit Reactor(LineParser parser);
+  ~Reactor();
+
+  Reactor(const Reactor&) = delete;
+  Reactor& operator=(const Reactor&) = delete;
+
+  /**
+   * @brief Blokuje, dokud nepřijde vstup nebo nevyprší časovač.
+   */
+  Ready Wait();
+
+  /**
+   * @brief Vyjme další rozebraný řádek ze stdin.
+   * @details Uvolní čtecí vlákno, pokud čeká na místo v plné frontě.
+   * @return false pokud žádný nečeká.
+   */
+  bool Pop(StdinEvent& event);
+
+  /**
+   * @brief Nastaví časovač na absolutní termín (nahrazuje předchozí).
+   */
+  void ArmTimer(std::chrono::steady_clock::time_point deadline);
+
+  /**
+   * @brief Zruší nastavený časovač.
+   */
+  void DisarmTimer();
+
+  /**
+   * @brief Probudí Wait z jiného vlákna (bez nové položky ve frontě).
+   */
+  void Wake();
+
+ private:
+  void ReadLoop();
+  void Push(StdinEvent&& event);
+
+  LineParser parse;
+  SpscQueue<StdinEvent, 256> queue{};
+  int epollFd = -1; /**< epoll nad timerFd a wakeFd */
+  int timerFd = -1; /**< timerfd s CLOCK_MONOTONIC */
+  int wakeFd = -1;  /**< eventfd, čtecí vlákno jím hlásí nové položky */
+  int stopFd = -1;  /**< eventfd, kterým se ukončuje čtecí vlákno */
+  int drainFd = -1; /**< eventfd, Pop jím uvolní čtecí vlákno u plné fronty */
+  std::atomic<bool> stopping{false};
+  std::atomic<bool> producerWaiting{false}; /**< Čtecí vlákno čeká na místo */
+  std::thread reader;
+};
+
+#endif
+
+}  // namespace EventLoop
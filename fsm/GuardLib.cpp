@@ -0,0 +1,809 @@
+#include "GuardLib.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace GuardLib {
+
+namespace {
+
+/// Maximální hloubka zásobníku při vyhodnocení
+constexpr size_t MaxDepth = 16;
+
+/// Výraz nepatří do podporované podmnožiny
+struct Unsupported {};
+
+bool IsNumber(const Value& v) {
+  return std::holds_alternative<int64_t>(v) || std::holds_alternative<double>(v);
+}
+
+double AsDouble(const Value& v) {
+  if (const auto* i = std::get_if<int64_t>(&v))
+    return static_cast<double>(*i);
+  return std::get<double>(v);
+}
+
+bool Truthy(const Value& v) {
+  if (std::holds_alternative<std::monostate>(v))
+    return false;
+  if (const auto* b = std::get_if<bool>(&v))
+    return *b;
+  return true;
+}
+
+/**
+ * @brief Převod řetězce na číslo podle pravidel Lua (tonumber, literály).
+ */
+std::optional<Value> ParseNumber(const std::string& text) {
+  size_t begin = 0;
+  size_t end = text.size();
+  while (begin < end && std::isspace(static_cast<unsigned char>(text[begin])))
+    ++begin;
+  while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1])))
+    --end;
+  if (begin == end)
+    return std::nullopt;
+
+  // Celé číslo: desítkové bez přetečení, šestnáctkové s přetečením modulo 2^64
+  {
+    size_t i = begin;
+    const bool negative = text[i] == '-';
+    if (text[i] == '-' || text[i] == '+')
+      ++i;
+    uint64_t value = 0;
+    bool digits = false;
+    bool overflow = false;
+    if (i + 1 < end && text[i] == '0' && (text[i + 1] == 'x' || text[i + 1] == 'X')) {
+      for (i += 2; i < end && std::isxdigit(static_cast<unsigned char>(text[i])); ++i) {
+        const auto c = static_cast<unsigned char>(text[i]);
+        value = value * 16 + (std::isdigit(c) ? c - '0' : std::tolower(c) - 'a' + 10);
+        digits = true;
+      }
+    } else {
+      for (; i < end && std::isdigit(static_cast<unsigned char>(text[i])); ++i) {
+        const auto d = static_cast<uint64_t>(text[i] - '0');
+        const auto limit = static_cast<uint64_t>(INT64_MAX) + (negative ? 1 : 0);
+        if (value > (limit - d) / 10)
+          overflow = true;
+        value = value * 10 + d;
+        digits = true;
+      }
+    }
+    if (digits && !overflow && i == end) {
+      if (negative)
+        value = 0 - value;
+      return static_cast<int64_t>(value);
+    }
+  }
+
+  // Lua odmítá 'inf' a 'nan', které strtod jinak přijme
+  const std::string number = text.substr(begin, end - begin);
+  if (number.find_first_of("nN") != std::string::npos)
+    return std::nullopt;
+  char* stop = nullptr;
+  const double value = std::strtod(number.c_str(), &stop);
+  if (stop != number.c_str() + number.size())
+    return std::nullopt;
+  return value;
+}
+
+std::optional<Value> Arithmetic(const OpCode op, const Value& a,
+                                const Value& b) {
+  // Koerce řetězců na čísla se nechává Lua
+  if (!IsNumber(a) || !IsNumber(b))
+    return std::nullopt;
+
+  if (std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b)) {
+    const auto x = static_cast<uint64_t>(std::get<int64_t>(a));
+    const auto y = static_cast<uint64_t>(std::get<int64_t>(b));
+    switch (op) {
+      case OpCode::Add:
+        return static_cast<int64_t>(x + y);
+      case OpCode::Sub:
+        return static_cast<int64_t>(x - y);
+      case OpCode::Mul:
+        return static_cast<int64_t>(x * y);
+      case OpCode::Mod: {
+        const auto m = std::get<int64_t>(a);
+        const auto n = std::get<int64_t>(b);
+        if (n == 0)
+          return std::nullopt;  // Lua vyhodí chybu "attempt to perform 'n%%0'"
+        if (n == -1)
+          return int64_t{0};
+        auto r = m % n;
+        if (r != 0 && (r ^ n) < 0)
+          r += n;
+        return r;
+      }
+      default:
+        break;
+    }
+  }
+
+  const auto x = AsDouble(a);
+  const auto y = AsDouble(b);
+  switch (op) {
+    case OpCode::Add:
+      return x + y;
+    case OpCode::Sub:
+      return x - y;
+    case OpCode::Mul:
+      return x * y;
+    case OpCode::Div:
+      return x / y;
+    case OpCode::Mod: {
+      auto m = std::fmod(x, y);
+      if ((m > 0) ? y < 0 : (m < 0 && y != m))
+        m += y;
+      return m;
+    }
+    default:
+      return std::nullopt;
+  }
+}
+
+bool Equal(const Value& a, const Value& b) {
+  if (IsNumber(a) && IsNumber(b)) {
+    if (std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b))
+      return std::get<int64_t>(a) == std::get<int64_t>(b);
+    return AsDouble(a) == AsDouble(b);
+  }
+  return a == b;
+}
+
+/// a < b (strict) nebo a <= b; nullopt pokud by Lua vyhodila chybu
+std::optional<bool> Less(const Value& a, const Value& b, const bool orEqual) {
+  if (IsNumber(a) && IsNumber(b)) {
+    if (std::holds_alternative<int64_t>(a) && std::holds_alternative<int64_t>(b)) {
+      const auto x = std::get<int64_t>(a);
+      const auto y = std::get<int64_t>(b);
+      return orEqual ? x <= y : x < y;
+    }
+    const auto x = AsDouble(a);
+    const auto y = AsDouble(b);
+    return orEqual ? x <= y : x < y;
+  }
+  const auto* x = std::get_if<std::string>(&a);
+  const auto* y = std::get_if<std::string>(&b);
+  if (x == nullptr || y == nullptr)
+    return std::nullopt;
+  return orEqual ? *x <= *y : *x < *y;
+}
+
+/// Lexikální jednotka podmínky
+struct Token {
+  enum Kind { Name, Number, String, Symbol, End };
+
+  Kind kind = End;
+  std::string text;
+  Value value{};
+};
+
+std::vector<Token> Tokenize(const std::string& source) {
+  static constexpr std::array<const char*, 13> Symbols = {
+      "==", "~=", "<=", ">=", "<", ">", "+", "-", "*", "/", "%", "(", ")"};
+
+  std::vector<Token> tokens;
+  size_t i = 0;
+  while (i < source.size()) {
+    const auto c = static_cast<unsigned char>(source[i]);
+    if (std::isspace(c)) {
+      ++i;
+      continue;
+    }
+
+    Token token;
+    if (std::isalpha(c) || c == '_') {
+      const auto start = i;
+      while (i < source.size() &&
+             (std::isalnum(static_cast<unsigned char>(source[i])) ||
+              source[i] == '_'))
+        ++i;
+      token.kind = Token::Name;
+      token.text = source.substr(start, i - start);
+    } else if (std::isdigit(c) ||
+               (c == '.' && i + 1 < source.size() &&
+                std::isdigit(static_cast<unsigned char>(source[i + 1])))) {
+      const auto start = i;
+      while (i < source.size()) {
+        const auto d = static_cast<unsigned char>(source[i]);
+        const auto prev = i > start ? std::tolower(source[i - 1]) : 0;
+        if (std::isalnum(d) || d == '.' ||
+            ((d == '+' || d == '-') && (prev == 'e' || prev == 'p')))
+          ++i;
+        else
+          break;
+      }
+      auto value = ParseNumber(source.substr(start, i - start));
+      if (!value.has_value())
+        throw Unsupported{};
+      token.kind = Token::Number;
+      token.value = std::move(value.value());
+    } else if (c == '"' || c == '\'') {
+      const auto end = source.find(static_cast<char>(c), i + 1);
+      if (end == std::string::npos)
+        throw Unsupported{};
+      token.kind = Token::String;
+      token.text = source.substr(i + 1, end - i - 1);
+      // Escape sekvence a víceřádkové řetězce se nechávají Lua
+      if (token.text.find_first_of("\\\n") != std::string::npos)
+        throw Unsupported{};
+      token.value = token.text;
+      i = end + 1;
+    } else if (source.compare(i, 2, "--") == 0) {
+      throw Unsupported{};  // komentář
+    } else if (c == ';' || c == ',') {
+      token.kind = Token::Symbol;
+      token.text = std::string(1, static_cast<char>(c));
+      ++i;
+    } else {
+      const auto* symbol = std::find_if(
+          Symbols.begin(), Symbols.end(), [&](const char* s) {
+            return source.compare(i, std::strlen(s), s) == 0;
+          });
+      if (symbol == Symbols.end())
+        throw Unsupported{};
+      // '//' (celočíselné dělení) podmnožina nepodporuje
+      if (source.compare(i, 2, "//") == 0)
+        throw Unsupported{};
+      token.kind = Token::Symbol;
+      token.text = *symbol;
+      i += token.text.size();
+    }
+    tokens.push_back(std::move(token));
+  }
+  tokens.emplace_back();
+  return tokens;
+}
+
+}  // namespace
+
+/**
+ * @class Parser
+ * @brief Rekurzivní sestup s prioritami operátorů podle Lua 5.4.
+ */
+class Parser {
+ public:
+  Parser(std::vector<Token> tokens, Resolver& resolver)
+      : tokens(std::move(tokens)), resolver(resolver) {}
+
+  Guard Parse() {
+    Accept(Token::Name, "return");
+    Expression();
+    Accept(Token::Symbol, ";");
+    if (Peek().kind != Token::End)
+      throw Unsupported{};
+    return std::move(guard);
+  }
+
+ private:
+  const Token& Peek() const { return tokens[pos]; }
+
+  bool Check(const Token::Kind kind, const char* text) const {
+    return Peek().kind == kind && Peek().text == text;
+  }
+
+  bool Accept(const Token::Kind kind, const char* text) {
+    if (!Check(kind, text))
+      return false;
+    ++pos;
+    return true;
+  }
+
+  void Expect(const Token::Kind kind, const char* text) {
+    if (!Accept(kind, text))
+      throw Unsupported{};
+  }
+
+  size_t Emit(const OpCode op, const uint32_t arg = 0, const int effect = 0) {
+    depth += effect;
+    if (depth > static_cast<int>(MaxDepth))
+      throw Unsupported{};
+    guard.code.push_back({op, arg});
+    return guard.code.size() - 1;
+  }
+
+  void Constant(Value value) {
+    guard.constants.push_back(std::move(value));
+    Emit(OpCode::Constant, static_cast<uint32_t>(guard.constants.size() - 1),
+         1);
+  }
+
+  void Expression() { Or(); }
+
+  /// and/or vrací jeden z operandů, proto skok ponechává hodnotu na zásobníku
+  void Or() {
+    And();
+    while (Accept(Token::Name, "or")) {
+      const auto jump = Emit(OpCode::JumpIfTrue, 0, -1);
+      And();
+      guard.code[jump].arg = static_cast<uint32_t>(guard.code.size());
+    }
+  }
+
+  void And() {
+    Comparison();
+    while (Accept(Token::Name, "and")) {
+      const auto jump = Emit(OpCode::JumpIfFalse, 0, -1);
+      Comparison();
+      guard.code[jump].arg = static_cast<uint32_t>(guard.code.size());
+    }
+  }
+
+  void Comparison() {
+    static const std::array<std::pair<const char*, OpCode>, 6> Operators = {{
+        {"==", OpCode::Eq},
+        {"~=", OpCode::Ne},
+        {"<", OpCode::Lt},
+        {"<=", OpCode::Le},
+        {">", OpCode::Gt},
+        {">=", OpCode::Ge},
+    }};
+    Additive();
+    while (true) {
+      const auto* op = std::find_if(
+          Operators.begin(), Operators.end(),
+          [this](const auto& o) { return Check(Token::Symbol, o.first); });
+      if (op == Operators.end())
+        return;
+      ++pos;
+      Additive();
+      Emit(op->second, 0, -1);
+    }
+  }
+
+  void Additive() {
+    Multiplicative();
+    while (true) {
+      if (Accept(Token::Symbol, "+")) {
+        Multiplicative();
+        Emit(OpCode::Add, 0, -1);
+      } else if (Accept(Token::Symbol, "-")) {
+        Multiplicative();
+        Emit(OpCode::Sub, 0, -1);
+      } else {
+        return;
+      }
+    }
+  }
+
+  void Multiplicative() {
+    Unary();
+    while (true) {
+      if (Accept(Token::Symbol, "*")) {
+        Unary();
+        Emit(OpCode::Mul, 0, -1);
+      } else if (Accept(Token::Symbol, "/")) {
+        Unary();
+        Emit(OpCode::Div, 0, -1);
+      } else if (Accept(Token::Symbol, "%")) {
+        Unary();
+        Emit(OpCode::Mod, 0, -1);
+      } else {
+        return;
+      }
+    }
+  }
+
+  void Unary() {
+    if (Accept(Token::Name, "not")) {
+      Unary();
+      Emit(OpCode::Not);
+    } else if (Accept(Token::Symbol, "-")) {
+      Unary();
+      Emit(OpCode::Negate);
+    } else {
+      Primary();
+    }
+  }
+
+  void Primary() {
+    const auto token = Peek();
+    ++pos;
+    switch (token.kind) {
+      case Token::Number:
+      case Token::String:
+        Constant(token.value);
+        return;
+      case Token::Symbol:
+        if (token.text != "(")
+          throw Unsupported{};
+        Expression();
+        Expect(Token::Symbol, ")");
+        return;
+      case Token::Name:
+        break;
+      case Token::End:
+        throw Unsupported{};
+    }
+
+    if (token.text == "true" || token.text == "false") {
+      Constant(token.text == "true");
+    } else if (token.text == "nil") {
+      Constant(std::monostate{});
+    } else if (token.text == "valueof" || token.text == "defined") {
+      Expect(Token::Symbol, "(");
+      if (Peek().kind != Token::String)
+        throw Unsupported{};
+      const auto slot = resolver.InputSlot(Peek().text);
+      ++pos;
+      Expect(Token::Symbol, ")");
+      if (slot == NoSlot) {
+        // Nedeklarovaný vstup je v Inputs vždy nil
+        Constant(token.text == "valueof" ? Value{} : Value{false});
+      } else {
+        Emit(token.text == "valueof" ? OpCode::Input : OpCode::Defined, slot,
+             1);
+      }
+    } else if (token.text == "tonumber") {
+      Expect(Token::Symbol, "(");
+      Expression();
+      Expect(Token::Symbol, ")");
+      Emit(OpCode::ToNumber);
+    } else if (IsKeyword(token.text) || Check(Token::Symbol, "(")) {
+      // Jiná volání funkcí a klíčová slova podmnožina nepodporuje
+      throw Unsupported{};
+    } else {
+      Emit(OpCode::Variable, resolver.VariableSlot(token.text), 1);
+    }
+  }
+
+  static bool IsKeyword(const std::string& name) {
+    static const std::array<const char*, 22> Keywords = {
+        "and",  "break", "do",       "else", "elseif", "end",
+        "false", "for",  "function", "goto", "if",     "in",
+        "local", "nil",  "not",      "or",   "repeat", "return",
+        "then",  "true", "until",    "while"};
+    return std::any_of(Keywords.begin(), Keywords.end(),
+                       [&](const char* k) { return name == k; });
+  }
+
+  std::vector<Token> tokens;
+  Resolver& resolver;
+  size_t pos = 0;
+  int depth = 0;
+  Guard guard;
+};
+
+std::optional<Guard> Compile(const std::string& source, Resolver& resolver) {
+  try {
+    return Parser(Tokenize(source), resolver).Parse();
+  } catch (const Unsupported&) {
+    return std::nullopt;
+  }
+}
+
+std::optional<bool> Guard::Evaluate(Scope& scope) const {
+  std::array<Value, MaxDepth> stack;
+  size_t sp = 0;
+
+  for (size_t pc = 0; pc < code.size(); ++pc) {
+    const auto [op, arg] = code[pc];
+    switch (op) {
+      case OpCode::Constant:
+        stack[sp++] = constants[arg];
+        break;
+      case OpCode::Variable: {
+        auto value = scope.Variable(arg);
+        if (!value.has_value())
+          return std::nullopt;
+        stack[sp++] = std::move(value.value());
+        break;
+      }
+      case OpCode::Input:
+        stack[sp++] = scope.Input(arg);
+        break;
+      case OpCode::Defined:
+        stack[sp++] = !std::holds_alternative<std::monostate>(scope.Input(arg));
+        break;
+      case OpCode::ToNumber: {
+        auto& top = stack[sp - 1];
+        if (std::holds_alternative<std::monostate>(top))
+          // tonumber(nil) vrací v Lua nil (chybou je jen tonumber() bez
+          // argumentu); tento případ se jen pro jistotu nechává na Lua
+          return std::nullopt;
+        if (const auto* s = std::get_if<std::string>(&top)) {
+          auto number = ParseNumber(*s);
+          top = number.has_value() ? std::move(number.value()) : Value{};
+        } else if (!IsNumber(top)) {
+          top = std::monostate{};
+        }
+        break;
+      }
+      case OpCode::Negate: {
+        auto& top = stack[sp - 1];
+        if (const auto* i = std::get_if<int64_t>(&top))
+          top = static_cast<int64_t>(0 - static_cast<uint64_t>(*i));
+        else if (const auto* d = std::get_if<double>(&top))
+          top = -*d;
+        else
+          return std::nullopt;
+        break;
+      }
+      case OpCode::Not:
+        stack[sp - 1] = !Truthy(stack[sp - 1]);
+        break;
+      case OpCode::Add:
+      case OpCode::Sub:
+      case OpCode::Mul:
+      case OpCode::Div:
+      case OpCode::Mod: {
+        auto result = Arithmetic(op, stack[sp - 2], stack[sp - 1]);
+        if (!result.has_value())
+          return std::nullopt;
+        stack[--sp - 1] = std::move(result.value());
+        break;
+      }
+      case OpCode::Eq:
+      case OpCode::Ne: {
+        const bool equal = Equal(stack[sp - 2], stack[sp - 1]);
+        stack[--sp - 1] = op == OpCode::Eq ? equal : !equal;
+        break;
+      }
+      case OpCode::Lt:
+      case OpCode::Le:
+      case OpCode::Gt:
+      case OpCode::Ge: {
+        const auto& a = stack[sp - 2];
+        const auto& b = stack[sp - 1];
+        const auto result =
+            op == OpCode::Lt   ? Less(a, b, false)
+            : op == OpCode::Le ? Less(a, b, true)
+            : op == OpCode::Gt ? Less(b, a, false)
+                               : Less(b, a, true);
+        if (!result.has_value())
+          return std::nullopt;
+        stack[--sp - 1] = result.value();
+        break;
+      }
+      case OpCode::JumpIfFalse:
+      case OpCode::JumpIfTrue:
+        if (Truthy(stack[sp - 1]) == (op == OpCode::JumpIfTrue))
+          pc = arg - 1;
+        else
+          --sp;
+        break;
+    }
+  }
+  return Truthy(stack[0]);
+}
+
+struct Switch::Test {
+  uint32_t input;
+  bool numeric; /**< Porovnává tonumber(valueof(...)) */
+  OpCode op;    /**< Porovnání se vstupem vlevo */
+  Value constant;
+};
+
+namespace {
+
+/// Největší celé číslo, které double vyjádří přesně
+constexpr double MaxExact = 9007199254740992.0;
+
+/// Číslo jako double, pokud převod nemění jeho hodnotu
+std::optional<double> Exact(const Value& v) {
+  if (const auto* i = std::get_if<int64_t>(&v)) {
+    const auto d = static_cast<double>(*i);
+    if (std::fabs(d) > MaxExact)
+      return std::nullopt;
+    return d;
+  }
+  if (const auto* d = std::get_if<double>(&v))
+    return *d;
+  return std::nullopt;
+}
+
+/// Interval hodnot, pro které platí konjunkce porovnání
+struct Interval {
+  double low = -HUGE_VAL;
+  double high = HUGE_VAL;
+  bool lowClosed = true;
+  bool highClosed = true;
+
+  void Lower(const double v, const bool closed) {
+    if (v > low || (v == low && !closed)) {
+      low = v;
+      lowClosed = closed;
+    }
+  }
+
+  void Upper(const double v, const bool closed) {
+    if (v < high || (v == high && !closed)) {
+      high = v;
+      highClosed = closed;
+    }
+  }
+
+  void Restrict(const OpCode op, const double v) {
+    if (op == OpCode::Eq || op == OpCode::Gt || op == OpCode::Ge)
+      Lower(v, op != OpCode::Gt);
+    if (op == OpCode::Eq || op == OpCode::Lt || op == OpCode::Le)
+      Upper(v, op != OpCode::Lt);
+  }
+
+  [[nodiscard]] bool Contains(const double x) const {
+    return (x > low || (lowClosed && x == low)) &&
+           (x < high || (highClosed && x == high));
+  }
+};
+
+}  // namespace
+
+std::optional<std::vector<Switch::Test>> Switch::Match(const Guard& guard) {
+  const auto& code = guard.code;
+  size_t pc = 0;
+
+  struct Operand {
+    bool input = false;
+    bool numeric = false;
+    uint32_t slot = NoSlot;
+    Value constant{};
+  };
+  // Input [ToNumber] nebo Constant [Negate]
+  const auto operand = [&](Operand& o) {
+    if (pc >= code.size())
+      return false;
+    const auto [op, arg] = code[pc++];
+    if (op == OpCode::Input) {
+      o.input = true;
+      o.slot = arg;
+      o.numeric = pc < code.size() && code[pc].op == OpCode::ToNumber;
+      pc += o.numeric ? 1 : 0;
+      return true;
+    }
+    if (op != OpCode::Constant)
+      return false;
+    o.constant = guard.constants[arg];
+    if (pc < code.size() && code[pc].op == OpCode::Negate) {
+      ++pc;
+      if (const auto* i = std::get_if<int64_t>(&o.constant))
+        o.constant = static_cast<int64_t>(0 - static_cast<uint64_t>(*i));
+      else if (const auto* d = std::get_if<double>(&o.constant))
+        o.constant = -*d;
+      else
+        return false;
+    }
+    return true;
+  };
+  const auto comparison = [&]() -> std::optional<Test> {
+    Operand a;
+    Operand b;
+    if (!operand(a) || !operand(b) || a.input == b.input || pc >= code.size())
+      return std::nullopt;
+    auto op = code[pc++].op;
+    if (op != OpCode::Eq && op != OpCode::Lt && op != OpCode::Le &&
+        op != OpCode::Gt && op != OpCode::Ge)
+      return std::nullopt;
+    if (!a.input) {
+      std::swap(a, b);
+      op = op == OpCode::Lt   ? OpCode::Gt
+           : op == OpCode::Le ? OpCode::Ge
+           : op == OpCode::Gt ? OpCode::Lt
+           : op == OpCode::Ge ? OpCode::Le
+                              : op;
+    }
+    return Test{a.slot, a.numeric, op, std::move(b.constant)};
+  };
+
+  std::vector<Test> tests;
+  auto first = comparison();
+  if (!first.has_value())
+    return std::nullopt;
+  tests.emplace_back(std::move(first.value()));
+  if (pc < code.size()) {
+    // A and B: A; JumpIfFalse(konec); B
+    if (code[pc].op != OpCode::JumpIfFalse || code[pc].arg != code.size())
+      return std::nullopt;
+    ++pc;
+    auto second = comparison();
+    if (!second.has_value() || pc != code.size())
+      return std::nullopt;
+    tests.emplace_back(std::move(second.value()));
+  }
+  return tests;
+}
+
+std::optional<Switch> Switch::Build(const std::vector<const Guard*>& branches) {
+  Switch result;
+  std::vector<std::pair<Interval, uint32_t>> intervals;
+  size_t count = 0;
+  for (uint32_t i = 0; i < branches.size(); ++i) {
+    if (branches[i] == nullptr) {
+      result.otherwise = i;  // další větve se nikdy nevyhodnotí
+      break;
+    }
+    const auto tests = Match(*branches[i]);
+    if (!tests.has_value())
+      return std::nullopt;
+    if (count++ == 0) {
+      result.input = tests->front().input;
+      result.numeric = tests->front().numeric;
+    }
+
+    Interval interval;
+    for (const auto& test : tests.value()) {
+      if (test.input != result.input || test.numeric != result.numeric)
+        return std::nullopt;
+      if (!result.numeric) {
+        const auto* text = std::get_if<std::string>(&test.constant);
+        if (tests->size() != 1 || test.op != OpCode::Eq || text == nullptr)
+          return std::nullopt;
+        result.cases.try_emplace(*text, i);
+        continue;
+      }
+      const auto bound = Exact(test.constant);
+      if (!bound.has_value() || !std::isfinite(bound.value()))
+        return std::nullopt;
+      interval.Restrict(test.op, bound.value());
+    }
+    if (result.numeric)
+      intervals.emplace_back(interval, i);
+  }
+  if (count < 2)
+    return std::nullopt;
+  if (!result.numeric)
+    return result;
+
+  auto& points = result.points;
+  for (const auto& [interval, _] : intervals) {
+    for (const auto bound : {interval.low, interval.high}) {
+      if (std::isfinite(bound))
+        points.emplace_back(bound);
+    }
+  }
+  std::sort(points.begin(), points.end());
+  points.erase(std::unique(points.begin(), points.end()), points.end());
+
+  // Oblast 2k je mezera před points[k], oblast 2k+1 bod points[k]; uvnitř
+  // oblasti platí stejné podmínky, stačí vyzkoušet jednoho zástupce
+  const auto first = [&](const double x) {
+    for (const auto& [interval, branch] : intervals) {
+      if (interval.Contains(x))
+        return branch;
+    }
+    return result.otherwise;
+  };
+  const auto n = points.size();
+  result.regions.reserve(2 * n + 1);
+  for (size_t k = 0; k <= n; ++k) {
+    const double gap =
+        n == 0   ? 0.0
+        : k == 0 ? std::nextafter(points[0], -HUGE_VAL)
+        : k == n ? std::nextafter(points[n - 1], HUGE_VAL)
+                 : points[k - 1] / 2 + points[k] / 2;
+    result.regions.emplace_back(first(gap));
+    if (k < n)
+      result.regions.emplace_back(first(points[k]));
+  }
+  return result;
+}
+
+std::optional<uint32_t> Switch::Select(const Value& value) const {
+  if (!numeric) {
+    const auto* text = std::get_if<std::string>(&value);
+    if (text == nullptr)
+      return std::nullopt;
+    const auto it = cases.find(*text);
+    return it == cases.end() ? otherwise : it->second;
+  }
+
+  std::optional<double> x;
+  if (const auto* text = std::get_if<std::string>(&value)) {
+    if (const auto number = ParseNumber(*text); number.has_value())
+      x = Exact(number.value());
+  } else {
+    x = Exact(value);
+  }
+  // Neplatné číslo: porovnání s nil je v Lua chyba, rozhodne chunk
+  if (!x.has_value() || std::isnan(x.value()))
+    return std::nullopt;
+  const auto it = std::lower_bound(points.begin(), points.end(), x.value());
+  const auto k = static_cast<size_t>(it - points.begin());
+  return regions[it != points.end() && *it == x.value() ? 2 * k + 1 : 2 * k];
+}
+
+}  // namespace GuardLib
@@ -0,0 +1,169 @@
+/**
+ * @file   GuardLib.h
+ * @brief  Deklaruje nativní vyhodnocovač jednoduchých podmínek přechodů.
+ * @details
+ * Většina podmínek jsou prosté výrazy typu @c count < cycles nebo
+ * @c valueof("in") == "2". Guard takové výrazy přeloží do malého zásobníkového
+ * bytecode, který se vyhodnotí v C++ bez volání Lua. Podporovaná podmnožina:
+ * literály (čísla, řetězce bez escape sekvencí, true/false/nil), čtení
+ * proměnných, valueof/defined s řetězcovým literálem, tonumber, aritmetika
+ * + - * / %, porovnání a and/or/not. Výraz mimo podmnožinu se nepřeloží,
+ * situace, kdy by Lua vyhodila chybu nebo provedla koerci, vrací při
+ * vyhodnocení nullopt a volající použije Lua chunk.
+ *
+ * Switch sloučí sourozenecké podmínky, které porovnávají jeden vstup
+ * s různými konstantami, do vyhledání v hash tabulce nebo v seřazených
+ * intervalech, takže výběr přechodu nezávisí na počtu větví.
+ * @date   2025-05-11
+ */
+#pragma once
+
+#include <absl/container/flat_hash_map.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+namespace GuardLib {
+
+/// Lua hodnota podporovaná evaluátorem (monostate = nil)
+using Value = std::variant<std::monostate, bool, int64_t, double, std::string>;
+
+/// Slot, který neodpovídá žádnému deklarovanému vstupu
+inline constexpr uint32_t NoSlot = UINT32_MAX;
+
+/**
+ * @class Resolver
+ * @brief Přiřazuje jménům vstupů a proměnných sloty při překladu.
+ */
+class Resolver {
+ public:
+  virtual ~Resolver() = default;
+
+  /// Slot deklarovaného vstupu nebo NoSlot
+  virtual uint32_t InputSlot(const std::string& name) = 0;
+
+  /// Slot proměnné (každé jméno dostane vlastní)
+  virtual uint32_t VariableSlot(const std::string& name) = 0;
+};
+
+/**
+ * @class Scope
+ * @brief Zdroj hodnot proměnných a vstupů pro vyhodnocení podmínky.
+ */
+class Scope {
+ public:
+  virtual ~Scope() = default;
+
+  /**
+   * @brief Hodnota proměnné; nullopt pokud ji nelze vyjádřit jako Value.
+   */
+  virtual std::optional<Value> Variable(uint32_t slot) = 0;
+
+  /**
+   * @brief Hodnota vstupu (valueof) v deklarovaném slotu.
+   */
+  virtual const Value& Input(uint32_t slot) = 0;
+};
+
+/// Instrukce zásobníkového bytecode
+enum class OpCode : uint8_t {
+  Constant, /**< push constants[arg] */
+  Variable, /**< push proměnné ve slotu arg */
+  Input,    /**< push vstupu ve slotu arg */
+  Defined,  /**< push defined() vstupu ve slotu arg */
+  ToNumber,
+  Negate,
+  Not,
+  Add,
+  Sub,
+  Mul,
+  Div,
+  Mod,
+  Eq,
+  Ne,
+  Lt,
+  Le,
+  Gt,
+  Ge,
+  JumpIfFalse, /**< nepravdivý vrchol zůstane a skočí na arg, jinak pop */
+  JumpIfTrue,  /**< pravdivý vrchol zůstane a skočí na arg, jinak pop */
+};
+
+struct Instruction {
+  OpCode op;
+  uint32_t arg = 0;
+};
+
+/**
+ * @class Guard
+ * @brief Přeložená podmínka přechodu.
+ */
+class Guard {
+ public:
+  /**
+   * @brief Vyhodnotí podmínku stejně jako ExtractBool(Lua chunk).
+   * @return nullopt pokud je třeba vyhodnotit podmínku v Lua.
+   */
+  [[nodiscard]] std::optional<bool> Evaluate(Scope& scope) const;
+
+ private:
+  friend class Parser;
+  friend class Switch;
+
+  std::vector<Instruction> code{};
+  std::vector<Value> constants{};
+};
+
+/**
+ * @class Switch
+ * @brief Výběr první platné z podmínek porovnávajících jeden vstup.
+ * @details Větve tvaru @c valueof("x") == "c" se hledají v hash tabulce.
+ * Větve nad @c tonumber(valueof("x")) s ==, <, <=, >, >= (a dvojice takových
+ * porovnání spojená and) se převedou na intervaly; hranice intervalů dělí
+ * osu na oblasti, kterým je předem přiřazena první platná větev, a oblast
+ * hodnoty se najde půlením.
+ */
+class Switch {
+ public:
+  /**
+   * @brief Sestaví výběr z podmínek v pořadí vyhodnocení.
+   * @param branches Podmínky větví; nullptr je přechod bez podmínky.
+   * @return nullopt pokud některá podmínka nemá podporovaný tvar nebo jsou
+   * méně než dvě.
+   */
+  static std::optional<Switch> Build(const std::vector<const Guard*>& branches);
+
+  /// Slot vstupu, který větve porovnávají
+  [[nodiscard]] uint32_t Input() const { return input; }
+
+  /**
+   * @brief Najde první větev, jejíž podmínka pro hodnotu vstupu platí.
+   * @return Pozice větve, NoSlot pokud žádná neplatí, nebo nullopt pokud je
+   * třeba podmínky vyhodnotit jednotlivě (hodnota jiného typu).
+   */
+  [[nodiscard]] std::optional<uint32_t> Select(const Value& value) const;
+
+ private:
+  struct Test;
+
+  /// Rozloží podmínku na porovnání vstupu s konstantou
+  static std::optional<std::vector<Test>> Match(const Guard& guard);
+
+  uint32_t input = NoSlot;
+  uint32_t otherwise = NoSlot; /**< Pozice přechodu bez podmínky */
+  bool numeric = false;
+  absl::flat_hash_map<std::string, uint32_t> cases{};
+  std::vector<double> points{};    /**< Seřazené hranice intervalů */
+  std::vector<uint32_t> regions{}; /**< (-inf,p0), [p0], (p0,p1), ..., (pn,inf) */
+};
+
+/**
+ * @brief Pokusí se přeložit zdrojový text podmínky (případně s úvodním return).
+ * @return nullopt pokud výraz nepatří do podporované podmnožiny.
+ */
+std::optional<Guard> Compile(const std::string& source, Resolver& resolver);
+
+}  // namespace GuardLib
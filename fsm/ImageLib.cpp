@@ -0,0 +1,430 @@
+#include "ImageLib.h"
+
+#include <absl/log/log.h>
+#include <absl/strings/string_view.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Utils.h"
+#include "external/sol.hpp"
+
+namespace ImageLib {
+
+namespace {
+
+constexpr char Magic[4] = {'F', 'S', 'M', 'C'};
+constexpr uint32_t ByteOrder = 0x01020304;
+
+/**
+ * @class MappedFile
+ * @brief Soubor zpřístupněný jen pro čtení (mmap, jinde načtený do paměti).
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st {};
+    if (fd < 0 || fstat(fd, &st) < 0) {
+      if (fd >= 0)
+        close(fd);
+      LOG(ERROR) << "Failed to open image: " << path;
+      throw Utils::ProgramTermination();
+    }
+    size = static_cast<size_t>(st.st_size);
+    if (size != 0) {
+      mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+      mapping = nullptr;
+      LOG(ERROR) << "Failed to map image: " << path;
+      throw Utils::ProgramTermination();
+    }
+    data = static_cast<const char*>(mapping);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      LOG(ERROR) << "Failed to open image: " << path;
+      throw Utils::ProgramTermination();
+    }
+    buffer.assign(std::istreambuf_iterator<char>(file), {});
+    data = buffer.data();
+    size = buffer.size();
+#endif
+  }
+
+  ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapping != nullptr)
+      munmap(mapping, size);
+#endif
+  }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  [[nodiscard]] absl::string_view View() const { return {data, size}; }
+
+ private:
+  const char* data = nullptr;
+  size_t size = 0;
+#if defined(__unix__) || defined(__APPLE__)
+  void* mapping = nullptr;
+#else
+  std::string buffer;
+#endif
+};
+
+/// Sestavuje obraz do paměti
+class Writer {
+ public:
+  template <typename T>
+  void Put(const T value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    out.append(reinterpret_cast<const char*>(&value), sizeof value);
+  }
+
+  void Put(const EdgeRange range) {
+    Put(range.begin);
+    Put(range.end);
+  }
+
+  void PutString(const std::string& value) {
+    Put(static_cast<uint32_t>(value.size()));
+    out.append(value);
+  }
+
+  void PutStrings(const std::vector<std::string>& values) {
+    Put(static_cast<uint32_t>(values.size()));
+    for (const auto& value : values) {
+      PutString(value);
+    }
+  }
+
+  void PutArray(const std::vector<uint32_t>& values) {
+    Put(static_cast<uint32_t>(values.size()));
+    out.append(reinterpret_cast<const char*>(values.data()),
+               values.size() * sizeof(uint32_t));
+  }
+
+  [[nodiscard]] const std::string& Data() const { return out; }
+
+ private:
+  std::string out;
+};
+
+/// Čte obraz z namapované paměti s kontrolou mezí
+class Reader {
+ public:
+  explicit Reader(const absl::string_view data) : data(data) {}
+
+  template <typename T>
+  T Get() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, Take(sizeof value), sizeof value);
+    return value;
+  }
+
+  EdgeRange GetRange() {
+    EdgeRange range;
+    range.begin = Get<uint32_t>();
+    range.end = Get<uint32_t>();
+    return range;
+  }
+
+  std::string GetString() {
+    const auto size = Get<uint32_t>();
+    return std::string(Take(size), size);
+  }
+
+  std::vector<std::string> GetStrings() {
+    std::vector<std::string> values(Get<uint32_t>());
+    for (auto& value : values) {
+      value = GetString();
+    }
+    return values;
+  }
+
+  std::vector<uint32_t> GetArray() {
+    std::vector<uint32_t> values(Get<uint32_t>());
+    std::memcpy(values.data(), Take(values.size() * sizeof(uint32_t)),
+                values.size() * sizeof(uint32_t));
+    return values;
+  }
+
+  [[nodiscard]] bool AtEnd() const { return pos == data.size(); }
+
+ private:
+  const char* Take(const size_t size) {
+    if (data.size() - pos < size) {
+      LOG(ERROR) << "Image is truncated or corrupted";
+      throw Utils::ProgramTermination();
+    }
+    const auto* p = data.data() + pos;
+    pos += size;
+    return p;
+  }
+
+  absl::string_view data;
+  size_t pos = 0;
+};
+
+void Fail(const std::string& message) {
+  LOG(ERROR) << message;
+  throw Utils::ProgramTermination();
+}
+
+/// Všechny hodnoty id a intervalů ukazují dovnitř polí, na která odkazují
+bool Consistent(const CompiledAutomat& automat) {
+  const auto states = automat.StateCount();
+  const auto signals = automat.SignalCount();
+  const auto rows = automat.RowCount();
+  if (automat.signalTypes.size() != signals || automat.offsets.front() != 0 ||
+      automat.rowOffsets.front() != 0)
+    return false;
+  for (size_t i = 1; i < automat.offsets.size(); ++i) {
+    if (automat.offsets[i] < automat.offsets[i - 1])
+      return false;
+  }
+  for (size_t r = 1; r <= rows; ++r) {
+    if (automat.rowOffsets[r] < automat.rowOffsets[r - 1])
+      return false;
+  }
+  for (uint32_t s = 0; s < states; ++s) {
+    if (automat.rows[s] >= rows ||
+        automat.TargetsOf(s).size() != automat.EdgesOf(s).size())
+      return false;
+  }
+  for (const auto target : automat.targets) {
+    if (target >= states)
+      return false;
+  }
+  for (const auto& edge : automat.edges) {
+    if (edge.signal != NoId && edge.signal >= signals)
+      return false;
+  }
+
+  // Interval plánu smí obsahovat jen hrany vlastního řádku (Target)
+  const auto inRow = [&](const EdgeRange range, const size_t row) {
+    if (range.begin > range.end || range.end > automat.order.size())
+      return false;
+    for (const auto edge : automat.Order(range)) {
+      if (edge < automat.rowOffsets[row] || edge >= automat.rowOffsets[row + 1])
+        return false;
+    }
+    return true;
+  };
+  for (size_t r = 0; r < rows; ++r) {
+    const auto& plan = automat.plans[r];
+    if (!inRow(plan.free, r) || !inRow(plan.timers, r) ||
+        plan.buckets.begin > plan.buckets.end ||
+        plan.buckets.end > automat.buckets.size())
+      return false;
+    for (auto b = plan.buckets.begin; b < plan.buckets.end; ++b) {
+      const auto& bucket = automat.buckets[b];
+      if (bucket.signal >= signals || !inRow(bucket.untimed, r) ||
+          !inRow(bucket.timed, r))
+        return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool IsImage(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  char header[sizeof Magic]{};
+  return file.read(header, sizeof header) &&
+         std::memcmp(header, Magic, sizeof Magic) == 0;
+}
+
+void Write(const std::string& path, const CompiledAutomat& automat) {
+  if (automat.guardBytecode.size() != automat.edges.size() ||
+      automat.actionBytecode.size() != automat.StateCount() ||
+      automat.dispatchBytecode.size() != automat.order.size()) {
+    Fail("Cannot write image without compiled Lua chunks");
+  }
+
+  Writer w;
+  for (const auto c : Magic) {
+    w.Put(c);
+  }
+  w.Put(FormatVersion);
+  w.Put(ByteOrder);
+  w.Put(static_cast<uint32_t>(LUA_VERSION_NUM));
+
+  w.PutStrings(automat.stateNames);
+  w.PutStrings(automat.signalNames);
+  for (const auto type : automat.signalTypes) {
+    w.Put(static_cast<uint8_t>(type));
+  }
+  w.PutStrings(automat.outputNames);
+
+  w.Put(static_cast<uint32_t>(automat.variables.size()));
+  for (const auto& variable : automat.variables) {
+    w.PutString(variable.Type);
+    w.PutString(variable.Name);
+    w.PutString(variable.Value);
+  }
+
+  w.Put(static_cast<uint8_t>(automat.selection));
+  w.PutArray(automat.rows);
+  w.PutArray(automat.offsets);
+  w.PutArray(automat.targets);
+  w.PutArray(automat.transitions);
+  w.PutArray(automat.rowOffsets);
+  w.Put(static_cast<uint32_t>(automat.edges.size()));
+  for (const auto& edge : automat.edges) {
+    w.Put(edge.signal);
+    w.Put(static_cast<int32_t>(edge.delay));
+    w.Put(static_cast<uint8_t>(edge.guarded));
+  }
+
+  w.Put(static_cast<uint32_t>(automat.plans.size()));
+  for (const auto& plan : automat.plans) {
+    w.Put(plan.free);
+    w.Put(plan.timers);
+    w.Put(plan.buckets);
+    w.Put(static_cast<uint8_t>(plan.inputs));
+    w.Put(static_cast<uint8_t>(plan.timedInputs));
+    w.PutString(plan.requestInputs);
+  }
+
+  w.PutArray(automat.order);
+  w.Put(static_cast<uint32_t>(automat.buckets.size()));
+  for (const auto& bucket : automat.buckets) {
+    w.Put(bucket.signal);
+    w.Put(bucket.untimed);
+    w.Put(bucket.timed);
+  }
+
+  // Zdroje podmínek slouží nativnímu vyhodnocení (GuardLib)
+  w.PutStrings(automat.guardSources);
+  w.PutStrings(automat.guardBytecode);
+  w.PutStrings(automat.actionBytecode);
+  w.PutStrings(automat.dispatchBytecode);
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(w.Data().data(), static_cast<std::streamsize>(w.Data().size()));
+  if (!file) {
+    Fail("Failed to write image: " + path);
+  }
+}
+
+CompiledAutomat Load(const std::string& path) {
+  const MappedFile file(path);
+  Reader r(file.View());
+
+  for (const auto c : Magic) {
+    if (r.Get<char>() != c)
+      Fail("Not an fsm image: " + path);
+  }
+  if (r.Get<uint32_t>() != FormatVersion)
+    Fail("Unsupported image version, recompile the definition");
+  if (r.Get<uint32_t>() != ByteOrder)
+    Fail("Image was created on a machine with different byte order");
+  if (r.Get<uint32_t>() != LUA_VERSION_NUM)
+    Fail("Image was created for a different Lua version");
+
+  CompiledAutomat automat;
+  automat.stateNames = r.GetStrings();
+  automat.signalNames = r.GetStrings();
+  automat.signalTypes.resize(automat.SignalCount());
+  for (auto& type : automat.signalTypes) {
+    const auto value = r.Get<uint8_t>();
+    if (value > static_cast<uint8_t>(SignalType::Bool))
+      Fail("Image is truncated or corrupted");
+    type = static_cast<SignalType>(value);
+  }
+  automat.outputNames = r.GetStrings();
+
+  automat.variables.resize(r.Get<uint32_t>());
+  for (auto& variable : automat.variables) {
+    variable.Type = r.GetString();
+    variable.Name = r.GetString();
+    variable.Value = r.GetString();
+  }
+  automat.IndexVariables();
+
+  const auto selection = r.Get<uint8_t>();
+  if (selection > static_cast<uint8_t>(Selection::EvaluateAll))
+    Fail("Image is truncated or corrupted");
+  automat.selection = static_cast<Selection>(selection);
+  automat.rows = r.GetArray();
+  automat.offsets = r.GetArray();
+  automat.targets = r.GetArray();
+  automat.transitions = r.GetArray();
+  automat.rowOffsets = r.GetArray();
+  automat.edges.resize(r.Get<uint32_t>());
+  for (auto& edge : automat.edges) {
+    edge.signal = r.Get<uint32_t>();
+    edge.delay = r.Get<int32_t>();
+    edge.guarded = r.Get<uint8_t>() != 0;
+  }
+
+  automat.plans.resize(r.Get<uint32_t>());
+  for (auto& plan : automat.plans) {
+    plan.free = r.GetRange();
+    plan.timers = r.GetRange();
+    plan.buckets = r.GetRange();
+    plan.inputs = r.Get<uint8_t>() != 0;
+    plan.timedInputs = r.Get<uint8_t>() != 0;
+    plan.requestInputs = r.GetString();
+  }
+
+  automat.order = r.GetArray();
+  automat.buckets.resize(r.Get<uint32_t>());
+  for (auto& bucket : automat.buckets) {
+    bucket.signal = r.Get<uint32_t>();
+    bucket.untimed = r.GetRange();
+    bucket.timed = r.GetRange();
+  }
+
+  automat.guardSources = r.GetStrings();
+  automat.guardBytecode = r.GetStrings();
+  automat.actionBytecode = r.GetStrings();
+  automat.dispatchBytecode = r.GetStrings();
+
+  const auto states = automat.StateCount();
+  if (!r.AtEnd() || states == 0 || automat.offsets.size() != states + 1 ||
+      automat.rows.size() != states || automat.rowOffsets.empty() ||
+      automat.plans.size() != automat.rowOffsets.size() - 1 ||
+      automat.actionBytecode.size() != states ||
+      automat.guardBytecode.size() != automat.edges.size() ||
+      automat.guardSources.size() != automat.edges.size() ||
+      automat.dispatchBytecode.size() != automat.order.size() ||
+      automat.transitions.size() != automat.targets.size() ||
+      automat.offsets.back() != automat.targets.size() ||
+      automat.rowOffsets.back() != automat.edges.size()) {
+    Fail("Image is truncated or corrupted");
+  }
+  if (!Consistent(automat))
+    Fail("Image is truncated or corrupted");
+
+  for (uint32_t s = 0; s < states; ++s) {
+    automat.stateIds.emplace(automat.stateNames[s], s);
+  }
+  for (uint32_t i = 0; i < automat.SignalCount(); ++i) {
+    automat.signalIds.emplace(automat.signalNames[i], i);
+  }
+  for (uint32_t i = 0; i < automat.outputNames.size(); ++i) {
+    automat.outputIds.emplace(automat.outputNames[i], i);
+  }
+  return automat;
+}
+
+}  // namespace ImageLib
@@ -0,0 +1,49 @@
+/**
+ * @file   ImageLib.h
+ * @brief  Deklaruje binární obraz přeloženého automatu (.fsmc).
+ * @details
+ * Obraz obsahuje CompiledAutomat včetně plánů stavů, zdrojů podmínek
+ * (pro GuardLib) a lua_dump bytecode všech podmínek, akcí a výběrových funkcí. Načtení obrazu
+ * tak přeskočí rozbor textové definice (ParserLib) i překlad Lua chunků;
+ * soubor se mapuje přes mmap.
+ *
+ * Formát (little/big endian podle stroje, který obraz vytvořil, kontroluje se):
+ * hlavička "FSMC", verze formátu, značka pořadí bajtů, LUA_VERSION_NUM,
+ * následují sekce v pevném pořadí, řetězce a pole mají u32 délku.
+ * @date   2025-05-11
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "types/all_types.h"
+
+namespace ImageLib {
+using namespace types;
+
+/// Verze formátu; zvyšuje se při každé nekompatibilní změně
+inline constexpr uint32_t FormatVersion = 7;
+
+/**
+ * @brief Zda soubor začíná hlavičkou obrazu.
+ */
+bool IsImage(const std::string& path);
+
+/**
+ * @brief Zapíše obraz automatu.
+ * @attention guardBytecode, actionBytecode a dispatchBytecode musí být
+ * vyplněné.
+ */
+void Write(const std::string& path, const CompiledAutomat& automat);
+
+/**
+ * @brief Načte obraz automatu; chybný nebo nekompatibilní obraz ukončí program.
+ * @details Kontrolují se délky i rozsahy id a intervalů, takže poškozený obraz
+ * skončí chybou místo čtení mimo pole.
+ * @attention Obraz je důvěryhodný vstup: vložený Lua bytecode jde přímo do
+ * load_buffer a Lua bytecode ověřit nelze. Nenačítejte obrazy z cizích zdrojů.
+ */
+CompiledAutomat Load(const std::string& path);
+
+}  // namespace ImageLib
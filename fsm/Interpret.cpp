@@ -2,14 +2,18 @@
 
 #include <absl/log/log.h>
 #include <absl/strings/match.h>
+#include <absl/strings/str_cat.h>
 #include <absl/strings/str_join.h>
 #include <absl/time/time.h>
 #include <re2/re2.h>
 
 #include <algorithm>
+#include <iterator>
 #include <thread>
 #include <variant>
 
+#include "CompilerLib.h"
+#include "Scheduler.h"
 #include "Utils.h"
 #include "external/sol.hpp"
 
@@ -19,321 +23,98 @@ std::atomic<unsigned> types::Transition::counter = 0;
 
 namespace Interpreter {
 
-template <typename T>
-std::optional<T> TestAndSetValue(const std::string& _value) {
-  if constexpr (std::is_same_v<T, std::string>) {
-    return _value;
-  }
-  if constexpr (Utils::detail::IsNumeric<T>) {
-    return Utils::StringToNumeric<T>(_value);
-  }
-  return std::nullopt;
-}
-
-Interpret::Interpret(const AutomatLib::Automat& automat) {
-  transitionGroup.primary.reserve(automat.transitions.Size() +
-                                  5);  // Some reserve
-
-  transitionGroup = automat.transitions;
-  stateGroup = automat.states;
-  variableGroup = automat.variables;
-  inputs = automat.inputs;
-  outputs = automat.outputs;
-  activeState = stateGroup.First().Name;
-
-  lua.open_libraries(sol::lib::base);
-  lua.create_named_table("Inputs");
-  lua.create_named_table("Outputs");
-  lua.load(R"(
-    function output(name, value)
-      Outputs[name] = value
-      return name .. " = " .. value
-    end
-  )").call();
-  lua.load(R"(function defined(name) return Inputs[name] ~= nil end)").call();
-  lua.load(R"(function valueof(name) return Inputs[name] end)").call();
-
-  lua["elapsed"] = [&]() { return timer.elapsed<>(); };
-}
-
-Interpret::InterpretedValue Interpret::InterpretResult(
-    const sol::object& result) {
-  if (result.is<bool>()) {
-    return result.as<bool>();
-  }
-  if (result.is<int>()) {
-    return result.as<int>();
-  }
-  if (result.is<double>()) {
-    return result.as<double>();
-  }
-  if (result.is<std::string>()) {
-    return result.as<std::string>();
-  }
-  if (result.is<sol::table>()) {
-    return std::monostate{};
-  }
-  if (result.is<sol::function>()) {
-    return std::monostate{};
-  }
-  if (result.is<sol::nil_t>()) {
-    return std::monostate{};
-  }
-  LOG(ERROR) << "Unknown result type";
-  throw Utils::ProgramTermination();
-}
-
-void Interpret::ChangeState(const TransitionGroup& tg) {
-  timer.tock();
-
-  const auto cond_true = WhenConditionTrue(tg);
-
-  if (const auto t = cond_true.First(); t.has_value()) {
-    activeState = t.value().to;
-  } else {
-    LOG(ERROR) << "No next state found, but expected one";
-    throw Utils::ProgramTermination();
-  }
-  std::cout << "STATE: " << activeState << std::endl;
-  const auto [Name, Action] = stateGroupFunction.Find(activeState).First();
-  if (const auto result = Action(); result.valid()) {
-    const auto r = sol::object(result[0]);
-    const auto i_result = InterpretResult(r);
-    std::visit(
-        Utils::detail::Overloaded{
-            [](const std::string& val) {
-              std::cout << "OUTPUT: " << val << std::endl;
-            },
-            [](const bool val) { std::cout << "OUTPUT: " << val << std::endl; },
-            [](const int val) { std::cout << "OUTPUT: " << val << std::endl; },
-            [](const double val) {
-              std::cout << "OUTPUT: " << val << std::endl;
-            },
-            [](std::monostate val) {
-              LOG(ERROR) << "Result interpretation failed";
-              throw Utils::ProgramTermination();
-            }},
-        i_result);
-  } else {
-    const sol::error err = result;
-    LOG(ERROR) << err.what();
-    throw Utils::ProgramTermination();
-  }
-}
-
-bool Interpret::WaitShortestTimer(const TransitionGroup& group) {
-  if (const auto shortest = group.SmallestTimer(); shortest.has_value()) {
-    const auto duration = std::chrono::milliseconds(shortest.value().delayInt);
-    std::this_thread::sleep_for(duration);
-
-    ChangeState(group);
-    return true;
-  }
-  return false;
-}
-
-void Interpret::LinkDelays() {
-  auto hasDelay = transitionGroup.Where(
-      [](const Transition& tr) { return !tr.delay.empty(); });
-
-  if (hasDelay.None()) {
-    std::cerr << "No delay found" << std::endl;
-    return;
-  }
-
-  for (auto& v : variableGroup) {
-    auto mod = hasDelay.Where(
-        [v](const Transition& tr) { return tr.delay == v.Name; });
-    if (mod.None())
-      continue;
-
-    if (auto val = TestAndSetValue<int>(v.Value); val.has_value()) {
-      for (auto& [_, transition] : mod) {
-        transition.delayInt = val.value();
-      }
-    }
-    transitionGroup = transitionGroup.Merge(mod);
-  }
-  auto mod = TransitionGroup();
-  for (auto& [id, tr] : hasDelay) {
-    if (tr.delayInt != 0)
-      continue;
-
-    if (auto val = Utils::StringToNumeric<int>(tr.delay); val.has_value()) {
-      tr.delayInt = val.value();
-      mod << tr;
-    } else {
-      continue;
-    }
-  }
-  transitionGroup = transitionGroup.Merge(mod);
+namespace {
+
+/// Vypíše výsledek akce jako "<prefix>OUTPUT: <hodnota>"
+void PrintOutput(OutputLib::Sink& sink, const absl::string_view prefix,
+                 const Runtime::InterpretedValue& value) {
+  std::visit(Utils::detail::Overloaded{
+                 [&](const std::string& val) {
+                   sink.Line(prefix, "OUTPUT: ", val);
+                 },
+                 // Stejně jako dříve std::cout: true/false jako 1/0
+                 [&](const bool val) {
+                   sink.Line(prefix, "OUTPUT: ", static_cast<int>(val));
+                 },
+                 [&](const int val) { sink.Line(prefix, "OUTPUT: ", val); },
+                 [&](const double val) { sink.Line(prefix, "OUTPUT: ", val); },
+                 [](std::monostate) {}},
+             value);
 }
 
-void Interpret::PrepareVariables() {
-  for (const auto& variable : variableGroup.Get()) {
-    if (auto [Type, Name, Value] = variable.Tuple();
-        absl::EqualsIgnoreCase(Type, "int")) {
-      if (auto val = TestAndSetValue<int>(Value); val.has_value()) {
-        lua[Name] = val.value();
-      }
+}  // namespace
 
-    } else if (absl::EqualsIgnoreCase(Type, "float")) {
-      if (auto val = TestAndSetValue<float>(Value); val.has_value())
-        lua[Name] = val.value();
-    } else if (absl::EqualsIgnoreCase(Type, "double")) {
-      if (auto val = TestAndSetValue<double>(Value); val.has_value())
-        lua[Name] = val.value();
-      else
-        lua[Name] = Value;
-    } else if (absl::EqualsIgnoreCase(Type, "bool") ||
-               absl::EqualsIgnoreCase(Type, "string")) {
-      lua[Name] = Value;
-    }
-  }
-}
-
-void Interpret::PrepareStates() {
-  StateGroup<sol::protected_function> tg;
-  for (const auto& state : stateGroup) {
-    State<sol::protected_function> n{};
-    n.Name = state.Name;
-    if (const auto a = TestAndSet(state.Action);
-        a.has_value() && a.value().valid()) {
-      n.Action = a.value();
-    } else {
-      LOG(ERROR) << "Unexpected error while setting state action";
-      throw Utils::ProgramTermination();
-    }
-
-    stateGroupFunction.Add(n);
-  }
-}
+Interpret::Interpret(const AutomatLib::Automat& automat)
+    : _automat(automat) {}
 
-TransitionGroup Interpret::WhenConditionTrue(const TransitionGroup& group) {
-  TransitionGroup on_true;
-  for (const auto& [id, transition] : group.primary) {
-    if (!transition.hasCondition)
-      continue;
+Interpret::Interpret(Runtime::Definition definition)
+    : definition(std::move(definition)) {}
 
-    if (auto r = transition.function(); r.valid() && ExtractBool(r)) {
-      on_true.primary[id] = transition;
-    } else if (r.valid()) {
-    } else {
-      if (const auto something = TestAndSet(transition.condition);
-          something.has_value() && something.value().valid()) {
-        auto result = something.value()();
-      }
-      const sol::error err = r;
-      LOG(ERROR) << err.what();
-      throw Utils::ProgramTermination();
-    }
-  }
-  return on_true;
+void Interpret::Prepare() {
+  if (!definition) {
+    definition = std::make_shared<const CompiledAutomat>(
+        CompilerLib::Compiler().Compile(_automat));
+  }
+  signals = ProtocolLib::SignalTable(definition->signalNames);
+  program = std::make_unique<Runtime::Program>(
+      definition, virtualTime ? &virtualClock : nullptr);
+  program->checkGuards = checkGuards;
+
+  if (!sink)
+    sink = OutputLib::Sink::Open("-", OutputLib::FlushPolicy::Immediate);
+
+  program->onEnter = [this](const Runtime::Instance& inst, uint32_t) {
+    sink->Line("STATE: ", inst.StateName());
+  };
+  program->onOutput = [this](Runtime::Instance&,
+                             const Runtime::InterpretedValue& value) {
+    PrintOutput(*sink, "", value);
+  };
+
+  instance = program->Spawn();
 }
 
-std::optional<sol::protected_function> Interpret::TestAndSet(
-    const std::string& _cond) {
-  if (_cond.empty()) {
-    if (const auto zero = lua.load("return true"); zero.valid()) {
-      return zero.get<sol::protected_function>();
-    }
-    return std::nullopt;
-  }
-  std::string chunk_to_load;
-  if (!Utils::Contains(_cond, "return")) {
-    chunk_to_load = "return " + _cond;
+void Interpret::WaitUntil(const Runtime::Clock::time_point deadline) {
+  if (virtualTime) {
+    virtualClock.advance_to(deadline);
   } else {
-    chunk_to_load = _cond;
-  }
-
-  if (const auto primary = lua.load(chunk_to_load); primary.valid()) {
-    return primary.get<sol::protected_function>();
-  } else {
-    const sol::error primary_error = primary;
-    LOG(ERROR) << primary_error.what();
-    if (const auto secondary = lua.load("return true"); secondary.valid()) {
-      return secondary.get<sol::protected_function>();
-    } else {
-      const sol::error secondary_error = secondary;
-      LOG(ERROR) << secondary_error.what();
-      return std::nullopt;
-    }
+    sink->Idle();
+    std::this_thread::sleep_until(deadline);
   }
 }
 
-bool Interpret::ExtractBool(const sol::protected_function_result& result) {
-  if (!result.valid()) {
-    const sol::error r_error = result;
-    LOG(ERROR) << absl::StrFormat("Lua runtime error during function call: %v",
-                                  r_error.what());
-    return false;
-  }
-
-  const auto ret = result[0];
-  const auto val_type = ret.get_type();
-
-  if (val_type == sol::type::nil) {
-    return false;
-  }
-  if (val_type == sol::type::boolean) {
-    return ret.get<bool>();
-  }
-  //? Anything that isn't 'nil' or 'false' is automatically true
-  return true;
-}
-
-void Interpret::PrepareTransitions() {
-  for (auto& [id, transition] : transitionGroup) {
-    if (auto r = TestAndSet(transition.condition);
-        r.has_value() && r.value().valid()) {
-      transition.function = r.value();
-      transition.hasCondition = transition.function.valid();
-    } else {
-      LOG(ERROR) << absl::StrFormat(
-          "Transition: %v -> %v; Error in lua runtime or missing correct "
-          "definition",
-          transition.from, transition.to);
-      throw Utils::ProgramTermination();
-    }
-  }
+void Interpret::RequestInputs() const {
+  if (instance->AcceptsInput())
+    sink->Line(instance->Plan().requestInputs);
 }
 
-void Interpret::PrepareSignals() {
-  for (auto& signal : inputs) {
-    lua["Inputs"][signal] = "";
-  }
-  for (auto& signal : outputs) {
-    lua["Outputs"][signal] = "";
-  }
-}
-
-void Interpret::Prepare() {
-  LinkDelays();
-  PrepareVariables();
-  PrepareTransitions();
-  PrepareStates();
-  PrepareSignals();
-}
-
-std::string Interpret::ExtractInput(const std::string& line) {
-  const auto l = Utils::RemovePrefix<false>(line, "input:");
-  // should be <name> = <value>
-  const auto s = Utils::Split(l, '=');
-  if (s.size() != 2) {
-    LOG(ERROR) << absl::StrFormat("Possibly malformed input: %v", line);
-    throw Utils::ProgramTermination();
-  }
-  auto name = Utils::Trim(s[0]);
-  auto value = Utils::Trim(s[1]);
-
-  if (const auto pos = std::find(inputs.begin(), inputs.end(), name);
-      pos == inputs.end()) {
-    LOG(ERROR) << "Cannot dynamically define new signals or required signal is "
-                  "missing";
-    throw Utils::ProgramTermination();
+ProtocolLib::LineKind Interpret::ParseLine(const absl::string_view line,
+                                           InputFrame& frame) const {
+  using ProtocolLib::LineKind;
+  absl::string_view bad;
+  const auto kind =
+      ProtocolLib::Parse(line, *definition, signals, frame, &bad);
+  switch (kind) {
+    case LineKind::Malformed:
+      LOG(ERROR) << absl::StrFormat("Possibly malformed input: %v", line);
+      break;
+    case LineKind::UnknownSignal:
+      LOG(ERROR) << "Cannot dynamically define new signals or required signal "
+                    "is missing: "
+                 << bad;
+      break;
+    case LineKind::InvalidValue:
+      LOG(ERROR) << absl::StrFormat("Invalid value of input: %v", bad);
+      break;
+    case LineKind::Log:
+      LOG(ERROR) << "Function 'log' is not implemented";
+      break;
+    case LineKind::Ignored:
+    case LineKind::Input:
+    case LineKind::Stop:
+      break;
   }
-  lua["Inputs"][name] = value;
-  return name;
+  return kind;
 }
 
 bool Interpret::ExtractCommand(const std::string& line) {
@@ -349,98 +130,243 @@ bool Interpret::ExtractCommand(const std::string& line) {
   return true;
 }
 
-std::pair<int, std::string> Interpret::ParseStdinInput(
-    const std::string& line) {
+std::pair<int, InputFrame> Interpret::ParseStdinInput(
+    const absl::string_view line) const {
+  using ProtocolLib::LineKind;
   // INPUT, CMD, LOG
-  if (Utils::Contains(line, "input")) {
-    std::string signalName = ExtractInput(line);
-    return {1, ExtractInput(line)};
-  }
-  if (Utils::Contains(line, "stop")) {
-    return {-1, ""};
+  InputFrame frame;
+  switch (ParseLine(line, frame)) {
+    case LineKind::Input:
+      return {1, std::move(frame)};
+    case LineKind::Stop:
+      return {-1, {}};
+    case LineKind::Ignored:
+      return {0, {}};
+    default:
+      throw Utils::ProgramTermination();
   }
-  if (Utils::Contains(line, "log")) {
-    LOG(ERROR) << "Function 'log' is not implemented";
-    throw Utils::ProgramTermination();
+}
+
+EventLoop::StdinEvent Interpret::ParseEvent(
+    const absl::string_view line) const {
+  using EventLoop::StdinEvent;
+  using ProtocolLib::LineKind;
+  StdinEvent event;
+  switch (ParseLine(line, event.inputs)) {
+    case LineKind::Input:
+      event.kind = StdinEvent::Input;
+      break;
+    case LineKind::Stop:
+      event.kind = StdinEvent::Stop;
+      break;
+    case LineKind::Ignored:
+      break;
+    default:
+      event.kind = StdinEvent::Error;
+      break;
   }
-  return {0, ""};
+  return event;
 }
 
 int Interpret::Execute() {
-  transitionGroup.GroupTransitions();
-  while (true) {
-    // First find all reachable transitions from current transition
-    auto transitions_v = transitionGroup.RetrieveEx(activeState);
-    /*if (!transitions.has_value()) {
-      LOG(ERROR) << "No transitions for state: " << activeState << std::endl;
-      break;
+  using Runtime::Step;
+
+  std::string line;
+  auto step = instance->Settle(program->Now());
+  while (step != Step::Halted) {
+    // Časovače mají přednost, vstupy se během čekání nečtou
+    if (const auto deadline = instance->NextDeadline(); deadline.has_value()) {
+      WaitUntil(deadline.value());
+      step = instance->Expire(deadline.value());
+      if (step == Step::Idle && !instance->NextDeadline().has_value()) {
+        LOG(ERROR) << "No next state found, but expected one";
+        throw Utils::ProgramTermination();
+      }
+      continue;
     }
 
-    auto& transitions_v = transitions.value();*/
+    RequestInputs();
 
-    if (transitions_v.None()) {
-      LOG(ERROR) << "No transitions for state: " << activeState << std::endl;
+    sink->Idle();
+    std::getline(std::cin, line);
+    auto [code, frame] = ParseStdinInput(line);
+    if (code == -1)
       break;
-    }
-    // Find all free transitions
-    if (auto r = transitions_v.WhereNone(); r.Some()) {
-      ChangeState(r);
+    if (code == 0)
       continue;
-    }
 
-    TransitionGroup event_true;
-    TransitionGroup event_false;
-    TransitionGroup timer_true;
-    TransitionGroup timer_false;
-
-    for (const auto& [fst, snd] : transitions_v) {
-      if (!snd.input.empty())
-        event_true << snd;
-      else
-        event_false << snd;
-
-      if (snd.delayInt == 0)
-        timer_false << snd;
-      else
-        timer_true << snd;
+    // Vstup s přechodem bez zpoždění musí přechod vyvolat
+    const bool expectsMove = instance->Plan().inputs;
+    step = instance->Input(std::move(frame), program->Now());
+    if (expectsMove && step == Step::Idle) {
+      LOG(ERROR) << "No next state found, but expected one";
+      throw Utils::ProgramTermination();
     }
+  }
+  return 0;
+}
 
-    if (auto zero = timer_false & event_false; zero.Some()) {
-      ChangeState(zero);
-      continue;
+int Interpret::ExecuteEvents() {
+  if (virtualTime) {
+    LOG(WARNING) << "Event loop runtime needs wall-clock time, using blocking "
+                    "loop";
+    return Execute();
+  }
+#ifdef __linux__
+  using EventLoop::StdinEvent;
+  using Runtime::Clock;
+  using Runtime::Step;
+
+  EventLoop::Reactor reactor(
+      [this](const absl::string_view line) { return ParseEvent(line); });
+
+  const auto arm = [&] {
+    if (const auto deadline = instance->NextDeadline(); deadline.has_value())
+      reactor.ArmTimer(deadline.value());
+    else
+      reactor.DisarmTimer();
+  };
+
+  if (instance->Settle(Clock::now()) == Step::Halted)
+    return 0;
+  arm();
+  RequestInputs();
+
+  bool inputOpen = true;
+  StdinEvent event;
+  while (true) {
+    if (!instance->NextDeadline().has_value() &&
+        (!inputOpen || !instance->AcceptsInput())) {
+      if (!inputOpen)
+        break;
+      LOG(ERROR) << "No next state found, but expected one";
+      throw Utils::ProgramTermination();
     }
 
-    if (auto first = timer_true & event_false; first.Some()) {
-      if (WaitShortestTimer(first))
-        continue;
-    }
+    sink->Idle();
+    const auto ready = reactor.Wait();
 
-    auto items = event_true.YieldInputNames();
-    std::cout << "REQUEST_INPUTS: " << absl::StrJoin(items, ", ") << std::endl;
+    if (ready.timer) {
+      const auto step = instance->Expire(Clock::now());
+      if (step == Step::Halted)
+        return 0;
+      arm();
+      if (step == Step::Moved)
+        RequestInputs();
+    }
 
-    std::string line;
-    std::getline(std::cin, line);
-    auto [code, signalName] = ParseStdinInput(line);
-    if (code == -1)
-      break;
-    if (code == 0)
+    if (!ready.input)
       continue;
 
-    if (auto second = event_true & timer_false; second.Some()) {
-      auto inputs = second.Where([signalName](const Transition& tr) {
-        return tr.input == signalName;
-      });
-      ChangeState(inputs);
-      continue;
+    // Všechny řádky, které se nahromadily, tvoří jeden krok
+    InputFrame frame;
+    bool stop = false;
+    bool error = false;
+    while (!stop && reactor.Pop(event)) {
+      switch (event.kind) {
+        case StdinEvent::Stop:
+          stop = true;
+          break;
+        case StdinEvent::Error:
+          stop = error = true;
+          break;
+        case StdinEvent::Closed:
+          inputOpen = false;
+          break;
+        case StdinEvent::Ignored:
+          break;
+        case StdinEvent::Input:
+          frame.insert(frame.end(),
+                       std::make_move_iterator(event.inputs.begin()),
+                       std::make_move_iterator(event.inputs.end()));
+          break;
+      }
+    }
+
+    if (!frame.empty()) {
+      // Přechod na vstup ruší všechny čekající časovače starého stavu
+      const auto step = instance->Input(std::move(frame), Clock::now());
+      if (step == Step::Halted)
+        return 0;
+      arm();
+      if (step == Step::Moved)
+        RequestInputs();
     }
+    if (error)
+      throw Utils::ProgramTermination();
+    if (stop)
+      return 0;
+  }
+  return 0;
+#else
+  LOG(WARNING) << "Event loop runtime requires Linux, using blocking loop";
+  return Execute();
+#endif
+}
 
-    if (auto third = event_true & timer_true; third.Some()) {
-      auto inputs = third.Where([signalName](const Transition& tr) {
-        return tr.input == signalName;
-      });
-      WaitShortestTimer(inputs);
+int Interpret::ExecuteFleet(const size_t instances, const size_t workers) {
+#ifdef __linux__
+  // Reaktor musí přežít fleet, jehož vlákna volají onDone
+  EventLoop::Reactor reactor(
+      [this](const absl::string_view line) { return ParseEvent(line); });
+#endif
+  Scheduler::Fleet fleet(definition, workers);
+
+  // Sink zamyká sám, řádky různých vláken se neproplétají
+  fleet.onEnter = [this](const size_t id, const std::string& state) {
+    sink->Line("#", id, " STATE: ", state);
+  };
+  fleet.onOutput = [this](const size_t id,
+                          const Runtime::InterpretedValue& value) {
+    PrintOutput(*sink, absl::StrCat("#", id, " "), value);
+  };
+  fleet.onIdle = [this] { sink->Idle(); };
+  if (checkGuards)
+    fleet.CheckGuards();
+
+  for (size_t i = 0; i < instances; ++i) {
+    fleet.Spawn();
+  }
+
+#ifdef __linux__
+  using EventLoop::StdinEvent;
+
+  fleet.onDone = [&reactor] { reactor.Wake(); };
+  fleet.Start();
+
+  StdinEvent event;
+  while (!fleet.Done()) {
+    sink->Idle();
+    reactor.Wait();
+    while (reactor.Pop(event)) {
+      switch (event.kind) {
+        case StdinEvent::Stop:
+          fleet.Stop();
+          break;
+        case StdinEvent::Error:
+          throw Utils::ProgramTermination();
+        case StdinEvent::Closed:
+          fleet.CloseInput();
+          break;
+        case StdinEvent::Ignored:
+          break;
+        case StdinEvent::Input:
+          fleet.Broadcast(event.inputs);
+          break;
+      }
     }
   }
+#else
+  LOG(WARNING) << "Fleet stdin requires Linux, running without inputs";
+  fleet.Start();
+  fleet.CloseInput();
+  fleet.Wait();
+#endif
+
+  fleet.Stop();
+  sink->Flush();
+  if (fleet.Failed())
+    throw Utils::ProgramTermination();
   return 0;
 }
-}  // namespace Interpreter
\ No newline at end of file
+}  // namespace Interpreter
@@ -4,15 +4,22 @@
  * @author xhlochm00 Michal Hloch
  * @author xzelni06 Robert Zelníček
  * @details
- * Třída Interpret uchovává instanci generovaného automatu, jeho stavy, přechody,
- * proměnné, vstupy a výstupy. Pomocí časovače z modulu Timing a Lua stavu řízení
- * běhu automatu zpracovává signály a přepíná mezi stavy.
+ * Třída Interpret uchovává instanci generovaného automatu, přeloží jej
+ * a jeho běh řídí přes jednu Runtime::Instance. Zpracovává signály ze stdin
+ * a vypisuje aktivní stavy a výstupy pro GUI.
  * @date   2025-05-10
  */
 #pragma once
 
+#include <absl/strings/string_view.h>
+
+#include <memory>
+
 #include "AutomatLib.h"
-#include "Stopwatch.h"
+#include "EventLoop.h"
+#include "OutputLib.h"
+#include "ProtocolLib.h"
+#include "Runtime.h"
 #include "types/all_types.h"
 
 namespace Interpreter {
@@ -23,91 +30,120 @@ using namespace types;
  * @brief Spouští a interpretuje běh konečného automatu.
  */
 class Interpret {
-  /// @brief Lua state for executing state actions and interpreting transition conditions
-  ///
-  /// @attention Important Sol2 lifetime management \n \n
-  /// 'sol::state lua' MUST be declared BEFORE all members that store (and thus is destroyed after all members that store ...)
-  /// 'sol::function' or 'sol::protected_function' objects (e.g., stateGroupFunction, transitionGroupFunction). \n \n
-  /// RATIONALE: C++ destructs member variables in the REVERSE order of their declaration.
-  /// 'lua' owns the underlying Lua state (lua_State*). If 'lua' is destroyed
-  /// BEFORE any 'sol::function'/'sol::protected_function' objects that reference it,
-  /// those objects will try to access a destroyed Lua state during their destruction,
-  /// leading to a use-after-free crash (0xC0000005).
-  sol::state lua{};
-
   /// Generovaný automat, který se bude interpretovat
   AutomatLib::Automat _automat;
   bool running = true;
 
-  /// Kolekce všech stavů automatu
-  StateGroup<> stateGroup{};
-  StateGroup<sol::protected_function> stateGroupFunction{};
-
-  /// Aktuální název stavu
-  std::string activeState = stateGroup.First().Name;
+  /// Simulovaný čas pro --virtual-time; musí přežít 'program'
+  VirtualClock<Runtime::Clock> virtualClock{};
+  bool virtualTime = false;
 
-  /// Kolekce všech proměnných automatu
-  VariableGroup variableGroup = _automat.variables;
+  /// Ověřovat nativní podmínky v Lua (--check-guards)
+  bool checkGuards = false;
 
-  /// Seznam registrovaných vstupních signálů
-  std::vector<std::string> inputs = _automat.inputs;
+  /// Přeložená definice automatu (vzniká v Prepare)
+  Runtime::Definition definition{};
 
-  /// Seznam registrovaných výstupních signálů
-  std::vector<std::string> outputs = _automat.outputs;
+  /// Perfektní hash jmen vstupů pro čtení stdin (vzniká v Prepare)
+  ProtocolLib::SignalTable signals{};
 
-  void ChangeState(const TransitionGroup& tg);
-  bool WaitShortestTimer(const TransitionGroup& group);
+  /// Kanál pro STATE:/OUTPUT: řádky; musí přežít 'program' (a fleet)
+  std::unique_ptr<OutputLib::Sink> sink{};
 
-  void LinkDelays();
+  /// @attention 'program' vlastní Lua stav, na který odkazuje i 'instance',
+  /// proto musí být deklarován před ní (a zničen až po ní).
+  std::unique_ptr<Runtime::Program> program{};
 
-  using InterpretedValue =
-      std::variant<std::monostate, bool, int, double, std::string>;
-
-  static InterpretedValue InterpretResult(const sol::object& result);
+  /// Jediná instance automatu, kterou interpret řídí
+  std::unique_ptr<Runtime::Instance> instance{};
 
   /**
-   * @brief Připraví proměnné v rámci Lua prostředí automatu.
+   * @brief Vypíše požadavek na vstupy, pokud na ně aktivní stav čeká.
    */
-  void PrepareVariables();
-  void PrepareStates();
+  void RequestInputs() const;
 
   /**
-   * @brief Načte a připraví přechodová pravidla z modelu automatu.
+   * @brief Počká do termínu; ve virtuálním čase jen posune hodiny.
    */
-  void PrepareTransitions();
+  void WaitUntil(Runtime::Clock::time_point deadline);
 
   /**
-   * @brief Inicializuje vstupní a výstupní signály před spuštěním.
+   * @brief Rozebere řádek protokolu a zaloguje chybu, pokud nastala.
+   * @details Nesahá na Lua stav, lze ji volat i ze čtecího vlákna.
+   * @param frame Sem se připíší vstupy řádku.
    */
-  void PrepareSignals();
+  ProtocolLib::LineKind ParseLine(absl::string_view line,
+                                  InputFrame& frame) const;
 
-  std::optional<sol::protected_function> TestAndSet(const std::string& _cond);
+ public:
+  /**
+   * @brief Provede kompletní přípravu interpretu voláním přípravných metod.
+   */
+  void Prepare();
 
-  static bool ExtractBool(const sol::protected_function_result& result);
+  /**
+   * @brief Přepne interpret na simulovaný čas (volá se před Prepare).
+   * @details Časovače se nevyčkávají, hodiny skočí rovnou na nejbližší termín
+   * a elapsed() v Lua vrací simulovaný čas.
+   */
+  void UseVirtualTime() { virtualTime = true; }
 
-  Timer<> timer{};
+  /**
+   * @brief Každou nativně vyhodnocenou podmínku ověří i v Lua (volá se před
+   * Prepare); rozdíl ukončí program.
+   */
+  void UseGuardCheck() { checkGuards = true; }
 
-  TransitionGroup WhenConditionTrue(const TransitionGroup& group);
+  /**
+   * @brief Nastaví výstupní kanál (volá se před Prepare).
+   * @details Bez volání se píše na stdout po každém řádku.
+   */
+  void UseSink(std::unique_ptr<OutputLib::Sink> output) {
+    sink = std::move(output);
+  }
 
- public:
-  /// Skupina přechodů vybraná k aktuálnímu zpracování
-  mutable TransitionGroup transitionGroup{};
+  explicit Interpret(const AutomatLib::Automat& automat);
 
   /**
-   * @brief Provede kompletní přípravu interpretu voláním přípravných metod.
+   * @brief Vytvoří interpret nad již přeloženou definicí (např. z obrazu .fsmc).
    */
-  void Prepare();
+  explicit Interpret(Runtime::Definition definition);
 
-  explicit Interpret(const AutomatLib::Automat& automat);
+  /**
+   * @brief Klasifikuje řádek ze stdin pro událostmi řízený běh (bez Lua).
+   * @details Nesahá na Lua stav, lze ji volat i ze čtecího vlákna.
+   */
+  EventLoop::StdinEvent ParseEvent(absl::string_view line) const;
 
-  std::string ExtractInput(const std::string& line);
   bool ExtractCommand(const std::string& line);
-  std::pair<int, std::string> ParseStdinInput(const std::string& line);
+
+  /**
+   * @brief Klasifikuje řádek ze stdin pro blokující běh.
+   * @return (1, snímek) pro vstup, (-1, {}) pro stop, jinak (0, {}).
+   */
+  std::pair<int, InputFrame> ParseStdinInput(absl::string_view line) const;
   /**
    * @brief Spustí vykonání automatu.
    * @return Výstupní kód nebo hodnota výsledku provedení.
    */
   int Execute();
+
+  /**
+   * @brief Spustí automat v režimu řízeném událostmi (epoll + timerfd).
+   * @details Vstupy jsou zpracovány i během čekání na zpoždění a přechod
+   * vyvolaný vstupem zruší čekající časovače. Mimo Linux volá Execute().
+   * @return Výstupní kód.
+   */
+  int ExecuteEvents();
+
+  /**
+   * @brief Spustí 'instances' nezávislých instancí na 'workers' vláknech.
+   * @details Vstupy ze stdin se předávají všem instancím, výpisy mají
+   * prefix "#<id> ". Končí, když všechny instance skončí, nebo po uzavření
+   * stdin, jakmile už žádná instance nečeká na časovač.
+   * @return Výstupní kód.
+   */
+  int ExecuteFleet(size_t instances, size_t workers);
 };
 
 }  // namespace Interpreter
@@ -0,0 +1,149 @@
+#include "OutputLib.h"
+
+#include <absl/log/log.h>
+#include <absl/strings/match.h>
+#include <absl/strings/numbers.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace OutputLib {
+
+std::optional<std::pair<FlushPolicy, std::chrono::microseconds>> ParsePolicy(
+    const std::string& text) {
+  using std::chrono::microseconds;
+  if (absl::EqualsIgnoreCase(text, "immediate"))
+    return std::make_pair(FlushPolicy::Immediate, microseconds(0));
+  if (absl::EqualsIgnoreCase(text, "batch"))
+    return std::make_pair(FlushPolicy::Batch, microseconds(0));
+  int64_t us = 0;
+  if (absl::SimpleAtoi(text, &us) && us > 0)
+    return std::make_pair(FlushPolicy::Interval, microseconds(us));
+  return std::nullopt;
+}
+
+std::unique_ptr<Sink> Sink::Open(const std::string& target,
+                                 const FlushPolicy policy,
+                                 const std::chrono::microseconds interval) {
+#ifdef __linux__
+  if (target == "-")
+    return std::unique_ptr<Sink>(
+        new Sink(STDOUT_FILENO, false, false, policy, interval));
+
+  if (absl::StartsWith(target, "unix:")) {
+    const auto path = target.substr(5);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof address.sun_path) {
+      LOG(ERROR) << "Invalid Unix socket path: " << path;
+      throw Utils::ProgramTermination();
+    }
+    std::memcpy(address.sun_path, path.data(), path.size());
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                          sizeof address) < 0) {
+      LOG(ERROR) << "Cannot connect to " << path << ": "
+                 << std::strerror(errno);
+      if (fd >= 0)
+        close(fd);
+      throw Utils::ProgramTermination();
+    }
+    return std::unique_ptr<Sink>(new Sink(fd, true, true, policy, interval));
+  }
+
+  // FIFO se otevírá stejně jako soubor, O_TRUNC se na ni nevztahuje
+  const int fd = open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      0644);
+  if (fd < 0) {
+    LOG(ERROR) << "Cannot open " << target << ": " << std::strerror(errno);
+    throw Utils::ProgramTermination();
+  }
+  return std::unique_ptr<Sink>(new Sink(fd, true, false, policy, interval));
+#else
+  if (target != "-") {
+    LOG(ERROR) << "Output sinks other than stdout require Linux";
+    throw Utils::ProgramTermination();
+  }
+  return std::unique_ptr<Sink>(new Sink(1, false, false, policy, interval));
+#endif
+}
+
+Sink::Sink(const int fd, const bool owned, const bool socket,
+           const FlushPolicy policy, const std::chrono::microseconds interval)
+    : fd(fd), owned(owned), socket(socket), policy(policy), interval(interval) {
+  if (policy == FlushPolicy::Interval)
+    flusher = std::thread([this] { FlushLoop(); });
+}
+
+Sink::~Sink() {
+  {
+    std::lock_guard lock(mutex);
+    stopping = true;
+    pending.notify_one();
+  }
+  if (flusher.joinable())
+    flusher.join();
+  // Zbytek bufferu se zapíše i při ukončení chybou
+  std::lock_guard lock(mutex);
+  FlushLocked();
+#ifdef __linux__
+  if (owned)
+    close(fd);
+#endif
+}
+
+void Sink::Flush() {
+  std::lock_guard lock(mutex);
+  FlushLocked();
+}
+
+void Sink::FlushLocked() {
+  // Lua print() píše přes stdio; jeho buffer musí odejít dřív než naše řádky
+  if (!owned)
+    std::fflush(stdout);
+  if (buffer.empty() || failed)
+    return;
+#ifdef __linux__
+  size_t written = 0;
+  while (written < buffer.size()) {
+    const auto* data = buffer.data() + written;
+    const auto size = buffer.size() - written;
+    const auto n = socket ? send(fd, data, size, MSG_NOSIGNAL)
+                          : write(fd, data, size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      LOG(ERROR) << "Failed to write output: " << std::strerror(errno);
+      failed = true;
+      break;
+    }
+    written += static_cast<size_t>(n);
+  }
+#else
+  std::fwrite(buffer.data(), 1, buffer.size(), stdout);
+  std::fflush(stdout);
+#endif
+  // clear() ponechá kapacitu, další řádky se skládají bez alokace
+  buffer.clear();
+}
+
+void Sink::FlushLoop() {
+  std::unique_lock lock(mutex);
+  while (!stopping) {
+    pending.wait(lock, [this] { return stopping || !buffer.empty(); });
+    // Řádky přibývají, dokud interval od prvního z nich neuplyne
+    pending.wait_for(lock, interval, [this] { return stopping; });
+    FlushLocked();
+  }
+}
+
+}  // namespace OutputLib
@@ -0,0 +1,120 @@
+/**
+ * @file   OutputLib.h
+ * @brief  Deklaruje výstupní kanál interpretu s bufferem a volbou flush.
+ * @details
+ * Řádky STATE:/OUTPUT:/REQUEST_INPUTS se skládají přes absl::StrAppend do
+ * jednoho znovupoužívaného bufferu a do kanálu (stdout, soubor, FIFO nebo
+ * Unix socket) se zapisují podle FlushPolicy. Výchozí Immediate zapisuje
+ * každý řádek hned, jako dříve std::endl; Batch a Interval šetří systémová
+ * volání při vysoké frekvenci přechodů.
+ * @date   2025-05-11
+ */
+#pragma once
+
+#include <absl/strings/str_cat.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "Utils.h"
+
+namespace OutputLib {
+
+/// Kdy se buffer zapíše do kanálu
+enum class FlushPolicy {
+  Immediate, /**< Po každém řádku (výchozí, GUI čte řádky hned) */
+  Batch,     /**< Když runtime dojde práce a bude čekat */
+  Interval   /**< Nejpozději interval po prvním nezapsaném řádku */
+};
+
+/**
+ * @brief Rozebere hodnotu volby --flush ("immediate", "batch" nebo počet µs).
+ * @return Politika a interval nebo nullopt pro neplatnou hodnotu.
+ */
+std::optional<std::pair<FlushPolicy, std::chrono::microseconds>> ParsePolicy(
+    const std::string& text);
+
+/**
+ * @class Sink
+ * @brief Výstupní kanál s bufferem; lze do něj psát z více vláken.
+ */
+class Sink {
+ public:
+  /**
+   * @brief Otevře kanál.
+   * @param target "-" = stdout, "unix:<cesta>" = Unix socket, jinak soubor
+   *               nebo FIFO (otevření FIFO čeká na čtenáře).
+   * @param interval Interval pro FlushPolicy::Interval.
+   */
+  static std::unique_ptr<Sink> Open(
+      const std::string& target, FlushPolicy policy,
+      std::chrono::microseconds interval = std::chrono::microseconds(0));
+
+  ~Sink();
+
+  Sink(const Sink&) = delete;
+  Sink& operator=(const Sink&) = delete;
+
+  /**
+   * @brief Připíše řádek složený z argumentů (cokoliv, co bere AlphaNum).
+   */
+  template <typename... Args>
+  void Line(const Args&... args) {
+    std::lock_guard lock(mutex);
+    if (failed)
+      throw Utils::ProgramTermination();
+    const bool empty = buffer.empty();
+    absl::StrAppend(&buffer, args...);
+    buffer += '\n';
+    if (policy == FlushPolicy::Immediate)
+      FlushLocked();
+    else if (policy == FlushPolicy::Interval && empty)
+      pending.notify_one();
+    if (failed)
+      throw Utils::ProgramTermination();
+  }
+
+  /**
+   * @brief Runtime bude čekat na vstup nebo časovač (konec dávky).
+   * @details U stdout odešle i text z Lua print(), který zatím čeká v stdio.
+   */
+  void Idle() {
+    if (policy == FlushPolicy::Batch)
+      Flush();
+    else if (!owned)
+      std::fflush(stdout);
+  }
+
+  /**
+   * @brief Zapíše buffer do kanálu bez ohledu na politiku.
+   */
+  void Flush();
+
+ private:
+  Sink(int fd, bool owned, bool socket, FlushPolicy policy,
+       std::chrono::microseconds interval);
+
+  void FlushLocked();
+  void FlushLoop();
+
+  int fd;
+  bool owned;  /**< Deskriptor se zavírá v destruktoru (false = stdout) */
+  bool socket; /**< Zapisuje se přes send (bez SIGPIPE) */
+  FlushPolicy policy;
+  std::chrono::microseconds interval;
+
+  std::mutex mutex;
+  std::condition_variable pending; /**< Buffer přestal být prázdný */
+  std::string buffer;
+  bool failed = false;   /**< Zápis selhal, další řádky se odmítají */
+  bool stopping = false;
+  std::thread flusher; /**< Jen pro FlushPolicy::Interval */
+};
+
+}  // namespace OutputLib
@@ -1,6 +1,7 @@
 #include "ParserLib.h"
 
 #include <absl/log/absl_log.h>
+#include <absl/strings/numbers.h>
 #include <absl/strings/str_split.h>
 #include <re2/re2.h>
 
@@ -22,13 +23,15 @@ Parser::Parser() {
       R"(\s*(?<type>\w+)\s*(?<name>\w+)\s*=\s*(?<value>\w+)\s*)", options);
   states_pattern_ =
       std::make_unique<RE2>(R"(state (?<name>\w+) *\[(?<code>.*)\])", options);
+  input_pattern_ = std::make_unique<RE2>(
+      R"(^\s*(?:(?<type>\w+)\s+)?(?<name>\w+)\s*$)", options);
   transitions_pattern_ = std::make_unique<RE2>(
-      R"(^\s*(?<from>\w+)\s*-->\s*(?<to>\w+)\s*:\s*(?:(?<input>\w*)?\s*(?<cond>\[.*\])?\s*@?\s*(\w*)?)\s*$)",
+      R"(^\s*(?<from>\w+)\s*-->\s*(?<to>\w+)\s*:\s*(?:(?<input>\w*)?\s*(?<cond>\[.*\])?\s*@?\s*(\w*)?)\s*(?:!\s*(?<priority>-?\d+))?\s*$)",
       options);
 
   if (!name_pattern_->ok() || !comment_pattern_->ok() ||
       !variables_pattern_->ok() || !states_pattern_->ok() ||
-      !transitions_pattern_->ok()) {
+      !transitions_pattern_->ok() || !input_pattern_->ok()) {
     ABSL_LOG(FATAL) << "Failed parsing regex patterns";
     throw Utils::ProgramTermination();
   }
@@ -132,8 +135,8 @@ void Parser::SectionHandler(const std::string &line,
       automat.addVariable(parseVariable(line));
       return;
     case Inputs: {
-      for (const auto &name : parseSignal<true>(line)) {
-        automat.addInput(name);
+      for (const auto &declaration : parseSignal<true>(line)) {
+        parseInput(declaration, automat);
       }
       return;
     }
@@ -208,13 +211,32 @@ Variable Parser::parseVariable(const std::string &line) const {
   throw Utils::ProgramTermination();
 }
 
+void Parser::parseInput(const std::string &declaration,
+                        AutomatLib::Automat &automat) const {
+  std::string type, name;
+  if (RE2::FullMatch(declaration, *input_pattern_, &type, &name) &&
+      SignalTypeOf(type).has_value()) {
+    automat.addInput(name, type);
+    return;
+  }
+
+  ABSL_LOG(ERROR) << absl::StrFormat("[%lu] Malformed input declaration: %s",
+                                     lineNumber, declaration);
+  throw Utils::ProgramTermination();
+}
+
 Transition Parser::parseTransition(const std::string &line) const {
-  std::string from, to, input, cond, delay;
+  std::string from, to, input, cond, delay, priority;
   if (RE2::FullMatch(line, *transitions_pattern_, &from, &to, &input, &cond,
-                     &delay)) {
+                     &delay, &priority)) {
     const auto cond2 = Utils::Remove(cond, '[');
     const auto cond3 = Utils::Remove(cond2, ']');
     auto t = Transition{from, to, input, Utils::Trim(cond3), delay};
+    if (!priority.empty() && !absl::SimpleAtoi(priority, &t.priority)) {
+      ABSL_LOG(ERROR) << absl::StrFormat("[%lu] Priority out of range: %s",
+                                         lineNumber, line);
+      throw Utils::ProgramTermination();
+    }
     return t;
   }
 
@@ -63,6 +63,12 @@ class Parser {
      */
   [[nodiscard]] Transition parseTransition(const std::string &line) const;
 
+  /**
+     * @brief Zparsuje deklaraci vstupu "jméno" nebo "typ jméno".
+     */
+  void parseInput(const std::string &declaration,
+                  AutomatLib::Automat &automat) const;
+
   /**
      * @brief Extrahuje jméno (Name nebo jakýkoliv text).
      */
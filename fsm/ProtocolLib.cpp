@@ -0,0 +1,263 @@
+#include "ProtocolLib.h"
+
+#include <absl/strings/ascii.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace ProtocolLib {
+
+namespace {
+
+/// Nejmenší mocnina dvou, která je alespoň n
+size_t PowerOfTwo(const size_t n) {
+  size_t size = 1;
+  while (size < n) size <<= 1;
+  return size;
+}
+
+/// Bílé znaky z obou konců (std::string_view se celý inlinuje)
+std::string_view Strip(std::string_view text) {
+  while (!text.empty() && absl::ascii_isspace(text.front()))
+    text.remove_prefix(1);
+  while (!text.empty() && absl::ascii_isspace(text.back()))
+    text.remove_suffix(1);
+  return text;
+}
+
+/// Shoda s malými písmeny slova 'word' bez ohledu na velikost písmen
+bool EqualsLower(const std::string_view text, const std::string_view word) {
+  for (size_t i = 0; i < word.size(); ++i) {
+    if (absl::ascii_tolower(text[i]) != word[i])
+      return false;
+  }
+  return true;
+}
+
+/// Slovo na začátku textu (bez ohledu na velikost písmen), odebere ho
+bool ConsumeKeyword(std::string_view& text, const std::string_view word) {
+  if (text.size() < word.size() || !EqualsLower(text, word))
+    return false;
+  if (text.size() > word.size()) {
+    const auto next = static_cast<unsigned char>(text[word.size()]);
+    if (absl::ascii_isalnum(next) || next == '_')
+      return false;
+  }
+  text.remove_prefix(word.size());
+  return true;
+}
+
+/// Obsahuje text slovo bez ohledu na velikost písmen (bez kopie)
+bool ContainsIgnoreCase(const std::string_view text,
+                        const std::string_view word) {
+  for (size_t i = 0; i + word.size() <= text.size(); ++i) {
+    if (EqualsLower(text.substr(i), word))
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief Najde ';', který odděluje další přiřazení.
+ * @details Oddělovačem je jen ';' následovaný "<deklarovaný vstup> =";
+ * jinak patří k hodnotě (řetězcový vstup smí ';' obsahovat).
+ */
+size_t NextSeparator(const std::string_view text, const SignalTable& signals) {
+  for (auto at = text.find(';'); at != std::string_view::npos;
+       at = text.find(';', at + 1)) {
+    const auto rest = Strip(text.substr(at + 1));
+    size_t end = 0;
+    while (end < rest.size() &&
+           (absl::ascii_isalnum(static_cast<unsigned char>(rest[end])) ||
+            rest[end] == '_'))
+      ++end;
+    const auto after = Strip(rest.substr(end));
+    if (end != 0 && !after.empty() && after.front() == '=' &&
+        signals.Find(absl::string_view(rest.data(), end)) != NoId)
+      return at;
+  }
+  return std::string_view::npos;
+}
+
+/// Převod zpět pro rozhraní s absl::string_view
+absl::string_view View(const std::string_view text) {
+  return absl::string_view(text.data(), text.size());
+}
+
+}  // namespace
+
+SignalTable::SignalTable(const std::vector<std::string>& names)
+    : names(names) {
+  // Se dvojnásobkem slotů se posuny najdou rychle; jinak větší tabulka
+  auto size = PowerOfTwo(std::max<size_t>(names.size() * 2, 1));
+  while (!Build(size)) size <<= 1;
+}
+
+uint64_t SignalTable::Hash(const absl::string_view name, const uint64_t seed) {
+  // FNV-1a s promíchaným seedem a závěrečným promícháním bitů
+  uint64_t h = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+  for (const char c : name) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 32;
+  h *= 0xD6E8FEB86659FD93ULL;
+  h ^= h >> 32;
+  return h;
+}
+
+bool SignalTable::Build(const size_t size) {
+  const auto groups = std::max<size_t>(size / 2, 1);
+  groupMask = groups - 1;
+  slotMask = size - 1;
+  displacements.assign(groups, 0);
+  slots.assign(size, NoId);
+
+  std::vector<std::vector<uint32_t>> members(groups);
+  for (uint32_t id = 0; id < names.size(); ++id) {
+    members[Hash(names[id], 0) & groupMask].push_back(id);
+  }
+  // Velké skupiny se rozmisťují první, dokud je volných slotů hodně
+  std::vector<uint32_t> order(groups);
+  for (uint32_t g = 0; g < groups; ++g) order[g] = g;
+  std::stable_sort(order.begin(), order.end(),
+                   [&](const uint32_t a, const uint32_t b) {
+                     return members[a].size() > members[b].size();
+                   });
+
+  constexpr uint32_t MaxDisplacement = 1u << 16;
+  std::vector<uint64_t> taken;
+  for (const auto g : order) {
+    if (members[g].empty())
+      break;
+    bool placed = false;
+    for (uint32_t d = 1; d < MaxDisplacement && !placed; ++d) {
+      taken.clear();
+      placed = true;
+      for (const auto id : members[g]) {
+        const auto slot = Hash(names[id], d) & slotMask;
+        if (slots[slot] != NoId ||
+            std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+          placed = false;
+          break;
+        }
+        taken.push_back(slot);
+      }
+      if (placed) {
+        displacements[g] = d;
+        for (size_t i = 0; i < taken.size(); ++i) {
+          slots[taken[i]] = members[g][i];
+        }
+      }
+    }
+    if (!placed)
+      return false;
+  }
+  return true;
+}
+
+uint32_t SignalTable::Find(const absl::string_view name) const {
+  if (names.empty())
+    return NoId;
+  const auto d = displacements[Hash(name, 0) & groupMask];
+  const auto id = slots[Hash(name, d) & slotMask];
+  return id != NoId && names[id] == name ? id : NoId;
+}
+
+LineKind Parse(const absl::string_view input, const CompiledAutomat& automat,
+               const SignalTable& signals, InputFrame& frame,
+               absl::string_view* bad) {
+  const std::string_view line(input.data(), input.size());
+  auto rest = Strip(line);
+  if (!ConsumeKeyword(rest, "input")) {
+    if (ContainsIgnoreCase(line, "stop"))
+      return LineKind::Stop;
+    if (ContainsIgnoreCase(line, "log"))
+      return LineKind::Log;
+    return LineKind::Ignored;
+  }
+
+  rest = Strip(rest);
+  if (!rest.empty() && rest.front() == ':')
+    rest.remove_prefix(1);
+  const auto start = frame.size();
+  const auto fail = [&](const LineKind kind, const std::string_view what) {
+    frame.erase(frame.begin() + static_cast<std::ptrdiff_t>(start),
+                frame.end());
+    if (bad != nullptr)
+      *bad = View(what);
+    return kind;
+  };
+
+  // <name> = <value> (; <name> = <value>)*
+  while (!rest.empty()) {
+    const auto split = NextSeparator(rest, signals);
+    const auto assignment = Strip(rest.substr(0, split));
+    rest = split == std::string_view::npos ? std::string_view()
+                                           : rest.substr(split + 1);
+    if (assignment.empty())
+      continue;
+
+    const auto eq = assignment.find('=');
+    if (eq == std::string_view::npos ||
+        assignment.find('=', eq + 1) != std::string_view::npos)
+      return fail(LineKind::Malformed, assignment);
+    const auto signal = signals.Find(View(Strip(assignment.substr(0, eq))));
+    if (signal == NoId)
+      return fail(LineKind::UnknownSignal, assignment);
+    auto value =
+        automat.SignalValue(signal, View(Strip(assignment.substr(eq + 1))));
+    if (!value.has_value())
+      return fail(LineKind::InvalidValue, assignment);
+    frame.emplace_back(signal, std::move(value.value()));
+  }
+  if (frame.size() == start)
+    return fail(LineKind::Malformed, line);
+  return LineKind::Input;
+}
+
+#ifdef __linux__
+
+LineReader::LineReader(const int fd, const size_t capacity)
+    : fd(fd), buffer(capacity) {}
+
+long LineReader::Fill() {
+  // Vydané řádky uvolní místo, nedokončený řádek se přesune na začátek
+  if (begin != 0) {
+    std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+    scan -= begin;
+    end -= begin;
+    begin = 0;
+  }
+  // Řádek delší než buffer
+  if (end == buffer.size())
+    buffer.resize(buffer.size() * 2);
+
+  const auto n = read(fd, buffer.data() + end, buffer.size() - end);
+  if (n > 0)
+    end += static_cast<size_t>(n);
+  return static_cast<long>(n);
+}
+
+bool LineReader::Next(absl::string_view& line) {
+  const auto* found = static_cast<const char*>(
+      std::memchr(buffer.data() + scan, '\n', end - scan));
+  if (found == nullptr) {
+    scan = end;
+    return false;
+  }
+  const auto newline = static_cast<size_t>(found - buffer.data());
+  line = absl::string_view(buffer.data() + begin, newline - begin);
+  begin = scan = newline + 1;
+  return true;
+}
+
+#endif
+
+}  // namespace ProtocolLib
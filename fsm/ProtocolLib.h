@@ -0,0 +1,122 @@
+/**
+ * @file   ProtocolLib.h
+ * @brief  Deklaruje čtení řádkového protokolu stdin bez kopírování.
+ * @details
+ * LineReader čte stdin do jednoho velkého bufferu a vydává řádky jako
+ * string_view přímo do něj. Parse rozebere řádek ("INPUT: a = 1; b = 2",
+ * stop, log) bez alokace: klíčová slova porovnává bez ohledu na velikost
+ * písmen na místě a jména vstupů převádí na id přes SignalTable, perfektní
+ * hash postavený z deklarovaného seznamu Input:. Alokuje se jen hodnota
+ * netypovaného (řetězcového) vstupu.
+ * @date   2025-05-11
+ */
+#pragma once
+
+#include <absl/strings/string_view.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types/all_types.h"
+
+namespace ProtocolLib {
+using namespace types;
+
+/**
+ * @class SignalTable
+ * @brief Perfektní hash jmen vstupů (hash and displace).
+ * @details Jméno se zahashuje do skupiny, posun skupiny určí jediný slot;
+ * hledání je tedy dva hashe a jedno porovnání řetězců bez ohledu na počet
+ * vstupů.
+ */
+class SignalTable {
+ public:
+  SignalTable() = default;
+
+  /**
+   * @param names Jména vstupů po id (CompiledAutomat::signalNames).
+   */
+  explicit SignalTable(const std::vector<std::string>& names);
+
+  /**
+   * @brief Převede jméno vstupu na id.
+   * @return Id signálu nebo NoId.
+   */
+  [[nodiscard]] uint32_t Find(absl::string_view name) const;
+
+ private:
+  static uint64_t Hash(absl::string_view name, uint64_t seed);
+
+  /// Zkusí rozmístit jména do 'size' slotů, false pokud se nepodaří
+  bool Build(size_t size);
+
+  std::vector<std::string> names{};
+  std::vector<uint32_t> displacements{}; /**< Posun po skupinách */
+  std::vector<uint32_t> slots{};         /**< Id jména po slotech (NoId) */
+  uint64_t groupMask = 0;
+  uint64_t slotMask = 0;
+};
+
+/// Druh řádku protokolu
+enum class LineKind {
+  Ignored,       /**< Prázdný nebo neznámý řádek */
+  Input,         /**< Snímek vstupů */
+  Stop,          /**< Ukončení běhu */
+  Log,           /**< Příkaz log (neimplementováno) */
+  Malformed,     /**< Vstup, který není "jméno = hodnota" */
+  UnknownSignal, /**< Vstup, který není deklarován */
+  InvalidValue   /**< Hodnota neodpovídá typu vstupu */
+};
+
+/**
+ * @brief Rozebere jeden řádek protokolu.
+ * @param frame Sem se připíší vstupy řádku; při chybě zůstane beze změny.
+ * @param bad   Při chybě vstupu sem uloží chybné přiřazení (může být nullptr).
+ */
+LineKind Parse(absl::string_view line, const CompiledAutomat& automat,
+               const SignalTable& signals, InputFrame& frame,
+               absl::string_view* bad = nullptr);
+
+#ifdef __linux__
+
+/**
+ * @class LineReader
+ * @brief Řádky ze souborového deskriptoru přes jeden znovupoužívaný buffer.
+ */
+class LineReader {
+ public:
+  explicit LineReader(int fd, size_t capacity = size_t{1} << 16);
+
+  /**
+   * @brief Přečte do bufferu, co je k dispozici (jedno volání read).
+   * @return Počet bajtů, 0 na konci vstupu, -1 při chybě (errno).
+   */
+  long Fill();
+
+  /**
+   * @brief Vydá další celý řádek bez '\n'.
+   * @attention Řádek ukazuje do bufferu a platí jen do dalšího Fill.
+   * @return false, pokud v bufferu žádný celý řádek není.
+   */
+  bool Next(absl::string_view& line);
+
+  /**
+   * @brief Nedokončený poslední řádek (po konci vstupu).
+   */
+  [[nodiscard]] absl::string_view Rest() const {
+    return absl::string_view(buffer.data() + begin, end - begin);
+  }
+
+ private:
+  int fd;
+  std::vector<char> buffer;
+  size_t begin = 0; /**< Začátek nevydaných dat */
+  size_t scan = 0;  /**< Odsud hledat další '\n' */
+  size_t end = 0;   /**< Konec přečtených dat */
+};
+
+#endif
+
+}  // namespace ProtocolLib
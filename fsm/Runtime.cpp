@@ -0,0 +1,1196 @@
+#include "Runtime.h"
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/log/log.h>
+#include <absl/strings/match.h>
+#include <absl/strings/str_format.h>
+#include <absl/strings/str_join.h>
+#include <absl/strings/string_view.h>
+
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
+#include "DependencyLib.h"
+#include "Utils.h"
+
+namespace Runtime {
+
+Program::Program(Definition definition, const ClockSource<Clock>* clock)
+    : definition(std::move(definition)), clock(clock) {
+  lua.open_libraries(sol::lib::base);
+
+  PrepareJumps();
+  PrepareHelpers();
+  PrepareVariables();
+  PrepareTransitions();
+  PrepareSwitches();
+  PrepareDispatchers();
+  PrepareDependencies();
+  PrepareStates();
+}
+
+namespace {
+
+static_assert(NoId == GuardLib::NoSlot);
+
+/// Vloží hodnotu slotu na Lua zásobník
+void Push(lua_State* L, const GuardLib::Value& value) {
+  std::visit(
+      [L](const auto& v) {
+        using T = std::decay_t<decltype(v)>;
+        if constexpr (std::is_same_v<T, std::monostate>)
+          lua_pushnil(L);
+        else if constexpr (std::is_same_v<T, bool>)
+          lua_pushboolean(L, v);
+        else if constexpr (std::is_same_v<T, int64_t>)
+          lua_pushinteger(L, static_cast<lua_Integer>(v));
+        else if constexpr (std::is_same_v<T, double>)
+          lua_pushnumber(L, v);
+        else
+          lua_pushlstring(L, v.data(), v.size());
+      },
+      value);
+}
+
+/// Převede skalární hodnotu ze zásobníku (nil = monostate), jinak nullopt
+std::optional<GuardLib::Value> StackValue(lua_State* L, const int index) {
+  switch (lua_type(L, index)) {
+    case LUA_TNIL:
+      return GuardLib::Value{};
+    case LUA_TBOOLEAN:
+      return GuardLib::Value{lua_toboolean(L, index) != 0};
+    case LUA_TNUMBER:
+      if (lua_isinteger(L, index))
+        return GuardLib::Value{static_cast<int64_t>(lua_tointeger(L, index))};
+      return GuardLib::Value{static_cast<double>(lua_tonumber(L, index))};
+    case LUA_TSTRING: {
+      size_t size = 0;
+      const char* data = lua_tolstring(L, index, &size);
+      return GuardLib::Value{std::string(data, size)};
+    }
+    default:
+      return std::nullopt;
+  }
+}
+
+/// Id jména na zásobníku; NoId pokud nejde o řetězec nebo jméno neexistuje
+uint32_t NameId(lua_State* L, const int index,
+                const absl::flat_hash_map<std::string, uint32_t>& ids) {
+  if (lua_type(L, index) != LUA_TSTRING)
+    return NoId;
+  size_t size = 0;
+  const char* data = lua_tolstring(L, index, &size);
+  const auto it = ids.find(absl::string_view(data, size));
+  return it == ids.end() ? NoId : it->second;
+}
+
+/// Slot z prvního argumentu C funkce s kontrolou rozsahu
+size_t CheckSlot(lua_State* L, const size_t size) {
+  const auto slot = luaL_checkinteger(L, 1);
+  luaL_argcheck(L, slot >= 0 && static_cast<size_t>(slot) < size, 1,
+                "invalid slot");
+  return static_cast<size_t>(slot);
+}
+
+/// Uloží hodnotu ze zásobníku do slotu; nepodporované typy se neukládají
+void Store(lua_State* L, const int index, GuardLib::Value& slot) {
+  if (auto value = StackValue(L, index); value.has_value())
+    slot = std::move(value.value());
+}
+
+/// Přiřazuje sloty podmínkám překládaným GuardLib
+class SlotResolver final : public GuardLib::Resolver {
+ public:
+  SlotResolver(const CompiledAutomat& automat, sol::state& lua,
+               std::vector<sol::reference>& keys)
+      : automat(automat), lua(lua), keys(keys) {}
+
+  uint32_t InputSlot(const std::string& name) override {
+    return automat.SignalId(name);
+  }
+
+  uint32_t VariableSlot(const std::string& name) override {
+    const auto [it, inserted] =
+        slots.try_emplace(name, static_cast<uint32_t>(keys.size()));
+    if (inserted)
+      keys.push_back(sol::make_reference(lua.lua_state(), name));
+    return it->second;
+  }
+
+ private:
+  const CompiledAutomat& automat;
+  sol::state& lua;
+  std::vector<sol::reference>& keys;
+  absl::flat_hash_map<std::string, uint32_t> slots;
+};
+
+bool IsIdentifier(const char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+size_t SkipSpaces(const std::string& s, size_t i) {
+  while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) ++i;
+  return i;
+}
+
+/// Délka otevírací dlouhé závorky ([[, [==[ ...) na pozici i, jinak 0
+size_t LongBracket(const std::string& s, const size_t i) {
+  if (i >= s.size() || s[i] != '[')
+    return 0;
+  auto j = i + 1;
+  while (j < s.size() && s[j] == '=') ++j;
+  return j < s.size() && s[j] == '[' ? j - i + 1 : 0;
+}
+
+/// Pozice za dlouhým řetězcem nebo komentářem s otevírací závorkou na i
+size_t SkipLong(const std::string& s, const size_t i, const size_t open) {
+  const auto close = "]" + std::string(open - 2, '=') + "]";
+  const auto end = s.find(close, i + open);
+  return end == std::string::npos ? s.size() : end + close.size();
+}
+
+/// Pozice za krátkým řetězcem začínajícím uvozovkou na i
+size_t SkipString(const std::string& s, size_t i) {
+  const char quote = s[i++];
+  while (i < s.size() && s[i] != quote) {
+    if (s[i] == '\\')
+      ++i;
+    ++i;
+  }
+  return std::min(i + 1, s.size());
+}
+
+/**
+ * @brief Přepíše valueof/defined/output("x", ...) s deklarovaným jménem
+ * na volání se slotem.
+ * @return Přepsaný text a pozice za ním, nebo nullopt.
+ */
+std::optional<std::pair<std::string, size_t>> BindCall(
+    const std::string& chunk, const size_t begin, const size_t end,
+    const CompiledAutomat& automat) {
+  const absl::string_view name(chunk.data() + begin, end - begin);
+  const bool output = name == "output";
+  if (!output && name != "valueof" && name != "defined")
+    return std::nullopt;
+
+  auto p = SkipSpaces(chunk, end);
+  if (p >= chunk.size() || chunk[p] != '(')
+    return std::nullopt;
+  p = SkipSpaces(chunk, p + 1);
+  if (p >= chunk.size() || (chunk[p] != '"' && chunk[p] != '\''))
+    return std::nullopt;
+  const auto close = chunk.find(chunk[p], p + 1);
+  if (close == std::string::npos)
+    return std::nullopt;
+  const absl::string_view literal(chunk.data() + p + 1, close - p - 1);
+  if (absl::StrContains(literal, '\\'))
+    return std::nullopt;
+
+  p = SkipSpaces(chunk, close + 1);
+  const char delimiter = output ? ',' : ')';
+  if (p >= chunk.size() || chunk[p] != delimiter)
+    return std::nullopt;
+  const auto id =
+      output ? automat.OutputId(literal) : automat.SignalId(literal);
+  if (id == NoId)
+    return std::nullopt;
+  return std::make_pair(absl::StrFormat("__%s(%d%c", name, id, delimiter),
+                        p + 1);
+}
+
+/**
+ * @brief Nahradí v Lua chunku volání s řetězcovým jménem signálu voláním
+ * se slotem; řetězce, komentáře a volání metod (a.valueof) nechá být.
+ */
+std::string BindSlots(const std::string& chunk,
+                      const CompiledAutomat& automat) {
+  std::string out;
+  out.reserve(chunk.size());
+  size_t i = 0;
+  while (i < chunk.size()) {
+    const char c = chunk[i];
+    auto next = i + 1;
+    if (c == '"' || c == '\'') {
+      next = SkipString(chunk, i);
+    } else if (const auto open = LongBracket(chunk, i); open != 0) {
+      next = SkipLong(chunk, i, open);
+    } else if (c == '-' && i + 1 < chunk.size() && chunk[i + 1] == '-') {
+      if (const auto comment = LongBracket(chunk, i + 2); comment != 0) {
+        next = SkipLong(chunk, i + 2, comment);
+      } else {
+        next = std::min(chunk.find('\n', i), chunk.size());
+      }
+    } else if (IsIdentifier(c)) {
+      while (next < chunk.size() && IsIdentifier(chunk[next])) ++next;
+      // Předchozí '.' (ne '..') nebo ':' znamená pole tabulky nebo metodu
+      auto k = i;
+      while (k > 0 && std::isspace(static_cast<unsigned char>(chunk[k - 1])))
+        --k;
+      const bool member =
+          k > 0 && (chunk[k - 1] == ':' ||
+                    (chunk[k - 1] == '.' && (k < 2 || chunk[k - 2] != '.')));
+      if (!member && !std::isdigit(static_cast<unsigned char>(c))) {
+        if (auto call = BindCall(chunk, i, next, automat); call.has_value()) {
+          out += call->first;
+          i = call->second;
+          continue;
+        }
+      }
+    }
+    out.append(chunk, i, next - i);
+    i = next;
+  }
+  return out;
+}
+
+}  // namespace
+
+void Program::Register(const char* name, const lua_CFunction function) {
+  lua_State* L = lua.lua_state();
+  lua_pushlightuserdata(L, this);
+  lua_pushcclosure(L, function, 1);
+  lua_setglobal(L, name);
+}
+
+void Program::PrepareHelpers() {
+  // Globální tabulka slouží prostředím instancí jako záloha pro knihovny
+  meta = lua.create_table();
+  meta["__index"] = lua.globals();
+
+  // Varianty se slotem vznikají přepsáním chunků (BindSlots)
+  Register("__valueof", &Program::ValueOf);
+  Register("__defined", &Program::Defined);
+  Register("__output", &Program::Output);
+  Register("valueof", &Program::InputByName);
+  Register("defined", &Program::DefinedByName);
+  Register("output", &Program::OutputByName);
+
+  // Inputs a Outputs jsou jen pohledy na sloty aktuální instance
+  lua_State* L = lua.lua_state();
+  const std::pair<lua_CFunction, lua_CFunction> proxies[] = {
+      {&Program::InputsIndex, &Program::InputsNewIndex},
+      {&Program::OutputsIndex, &Program::OutputsNewIndex}};
+  for (const auto& [index, newindex] : proxies) {
+    lua_newtable(L);
+    lua_newtable(L);
+    lua_pushlightuserdata(L, this);
+    lua_pushcclosure(L, index, 1);
+    lua_setfield(L, -2, "__index");
+    lua_pushlightuserdata(L, this);
+    lua_pushcclosure(L, newindex, 1);
+    lua_setfield(L, -2, "__newindex");
+    lua_setmetatable(L, -2);
+    lua_setglobal(L, index == &Program::InputsIndex ? "Inputs" : "Outputs");
+  }
+
+  lua.set_function("elapsed",
+                   [this]() { return current->timer.elapsed<>().count(); });
+}
+
+// C funkce nesmí mít při luaL_* chybě živé C++ objekty s destruktorem
+
+int Program::ValueOf(lua_State* L) {
+  const auto* self =
+      static_cast<Program*>(lua_touserdata(L, lua_upvalueindex(1)));
+  const auto slot = CheckSlot(L, self->current->inputs.size());
+  Push(L, self->current->inputs[slot]);
+  return 1;
+}
+
+int Program::Defined(lua_State* L) {
+  const auto* self =
+      static_cast<Program*>(lua_touserdata(L, lua_upvalueindex(1)));
+  const auto slot = CheckSlot(L, self->current->inputs.size());
+  lua_pushboolean(L, !std::holds_alternative<std::monostate>(
+                         self->current->inputs[slot]));
+  return 1;
+}
+
+int Program::Output(lua_State* L) {
+  const auto* self =
+      static_cast<Program*>(lua_touserdata(L, lua_upvalueindex(1)));
+  const auto slot = CheckSlot(L, self->current->outputs.size());
+  Store(L, 2, self->current->outputs[slot]);
+
+  const auto& name = self->Automat().outputNames[slot];
+  lua_pushlstring(L, name.data(), name.size());
+  lua_pushliteral(L, " = ");
+  lua_pushvalue(L, 2);
+  lua_concat(L, 3);
+  return 1;
+}
+
+int Program::InputByName(lua_State* L) {
+  const auto* self =
+      static_cast<Program*>(lua_touserdata(L, lua_upvalueindex(1)));
+  const auto id = NameId(L, 1, self->Automat().signalIds);
+  if (id == NoId)
+    lua_pushnil(L);
+  else
+    Push(L, self->current->inputs[id]);
+  return 1;
+}
+
+int Program::DefinedByName(lua_State* L) {
+  const auto* self =
+      static_cast<Program*>(lua_touserdata(L, lua_upvalueindex(1)));
+  const auto id = NameId(L, 1, self->Automat().signalIds);
+  lua_pushboolean(L, id != NoId && !std::holds_alternative<std::monostate>(
+                                       self->current->inputs[id]));
+  return 1;
+}
+
+int Program::OutputByName(lua_State* L) {
+  const auto* self =
+      static_cast<Program*>(lua_touserdata(L, lua_upvalueindex(1)));
+  if (const auto id = NameId(L, 1, self->Automat().outputIds); id != NoId)
+    Store(L, 2, self->current->outputs[id]);
+
+  lua_pushvalue(L, 1);
+  lua_pushliteral(L, " = ");
+  lua_pushvalue(L, 2);
+  lua_concat(L, 3);
+  return 1;
+}
+
+int Program::InputsIndex(lua_State* L) {
+  lua_remove(L, 1);
+  return InputByName(L);
+}
+
+int Program::InputsNewIndex(lua_State* L) {
+  const auto* self =
+      static_cast<Program*>(lua_touserdata(L, lua_upvalueindex(1)));
+  // Nedeklarované jméno nemá slot, zápis se zahodí
+  if (const auto id = NameId(L, 2, self->Automat().signalIds); id != NoId) {
+    Store(L, 3, self->current->inputs[id]);
+    self->current->TouchInput(id);
+  }
+  return 0;
+}
+
+int Program::OutputsIndex(lua_State* L) {
+  const auto* self =
+      static_cast<Program*>(lua_touserdata(L, lua_upvalueindex(1)));
+  const auto id = NameId(L, 2, self->Automat().outputIds);
+  if (id == NoId)
+    lua_pushnil(L);
+  else
+    Push(L, self->current->outputs[id]);
+  return 1;
+}
+
+int Program::OutputsNewIndex(lua_State* L) {
+  const auto* self =
+      static_cast<Program*>(lua_touserdata(L, lua_upvalueindex(1)));
+  if (const auto id = NameId(L, 2, self->Automat().outputIds); id != NoId)
+    Store(L, 3, self->current->outputs[id]);
+  return 0;
+}
+
+void Program::PrepareVariables() {
+  // Hodnoty jsou převedené podle typu už při překladu
+  const auto& automat = *definition;
+  variableNames.reserve(automat.variables.size());
+  for (size_t id = 0; id < automat.variables.size(); ++id) {
+    const auto& name = automat.variables[id].Name;
+    lua_State* L = lua.lua_state();
+    lua_pushlstring(L, name.data(), name.size());
+    variableNames.emplace_back(L, -1);
+    lua_pop(L, 1);
+
+    const auto& value = automat.variableValues[id];
+    if (std::holds_alternative<std::monostate>(value))
+      continue;
+    Push(L, value);
+    initial.emplace_back(name, sol::object(L, -1));
+    lua_pop(L, 1);
+  }
+}
+
+void Program::PrepareJumps() {
+  const auto& automat = *definition;
+  jumps.assign(automat.StateCount(), NoId);
+  for (uint32_t s = 0; s < automat.StateCount(); ++s) {
+    const auto free = automat.Order(automat.PlanOf(s).free);
+    if (free.empty() || automat.edges[free.front()].guarded)
+      continue;
+    // EvaluateAll vyhodnocuje i podmínky za vítězným přechodem
+    if (automat.selection == Selection::EvaluateAll &&
+        std::any_of(free.begin(), free.end(),
+                    [&](const uint32_t e) { return automat.edges[e].guarded; }))
+      continue;
+    jumps[s] = automat.Target(s, free.front());
+  }
+
+  // Řetěz skoků, který se vrátí do navštíveného stavu, by nikdy neskončil
+  enum : uint8_t { Unvisited, Open, Done };
+  std::vector<uint8_t> mark(jumps.size(), Unvisited);
+  for (uint32_t s = 0; s < jumps.size(); ++s) {
+    auto t = s;
+    while (t != NoId && mark[t] == Unvisited) {
+      mark[t] = Open;
+      t = jumps[t];
+    }
+    if (t != NoId && mark[t] == Open) {
+      std::vector<std::string> cycle{automat.stateNames[t]};
+      for (auto c = jumps[t]; c != t; c = jumps[c]) {
+        cycle.emplace_back(automat.stateNames[c]);
+      }
+      cycle.emplace_back(automat.stateNames[t]);
+      LOG(ERROR) << "Unconditional free transitions form a cycle: "
+                 << absl::StrJoin(cycle, " -> ");
+      throw Utils::ProgramTermination();
+    }
+    for (t = s; t != NoId && mark[t] == Open; t = jumps[t]) {
+      mark[t] = Done;
+    }
+  }
+}
+
+void Program::PrepareStates() {
+  const auto& automat = *definition;
+  actions.reserve(automat.StateCount());
+  for (size_t s = 0; s < automat.StateCount(); ++s) {
+    const auto a = automat.actionBytecode.empty()
+                       ? TestAndSet(automat.actionSources[s])
+                       : LoadBytecode(automat.actionBytecode[s]);
+    if (a.has_value() && a.value().valid()) {
+      actions.emplace_back(a.value());
+    } else {
+      LOG(ERROR) << "Unexpected error while setting state action";
+      throw Utils::ProgramTermination();
+    }
+  }
+}
+
+void Program::PrepareTransitions() {
+  const auto& automat = *definition;
+  guards.resize(automat.edges.size());
+  nativeGuards.resize(automat.edges.size());
+  SlotResolver resolver(automat, lua, variableKeys);
+  for (size_t e = 0; e < automat.edges.size(); ++e) {
+    if (!automat.edges[e].guarded)
+      continue;
+
+    // Lua chunk se připravuje i pro nativní podmínku jako záložní cesta
+    if (!automat.guardSources.empty())
+      nativeGuards[e] = GuardLib::Compile(automat.guardSources[e], resolver);
+
+    const auto r = automat.guardBytecode.empty()
+                       ? TestAndSet(automat.guardSources[e])
+                       : LoadBytecode(automat.guardBytecode[e]);
+    if (r.has_value() && r.value().valid()) {
+      guards[e] = r.value();
+    } else {
+      LOG(ERROR) << absl::StrFormat(
+          "Condition [%s]: Error in lua runtime or missing correct definition",
+          automat.guardSources[e]);
+      throw Utils::ProgramTermination();
+    }
+  }
+}
+
+std::optional<sol::protected_function> Program::TestAndSet(
+    const std::string& _cond) {
+  if (_cond.empty()) {
+    if (const auto zero = lua.load("return true"); zero.valid()) {
+      return zero.get<sol::protected_function>();
+    }
+    return std::nullopt;
+  }
+  // Chunk dostává prostředí instance jako argument, sdílí se tak mezi všemi
+  // instancemi bez nutnosti překládat jej pro každou zvlášť
+  std::string chunk_to_load = "local _ENV = ...; ";
+  if (!Utils::Contains(_cond, "return")) {
+    chunk_to_load += "return ";
+  }
+  chunk_to_load += BindSlots(_cond, *definition);
+
+  if (const auto primary = lua.load(chunk_to_load); primary.valid()) {
+    return primary.get<sol::protected_function>();
+  } else {
+    const sol::error primary_error = primary;
+    LOG(ERROR) << primary_error.what();
+    if (const auto secondary = lua.load("return true"); secondary.valid()) {
+      return secondary.get<sol::protected_function>();
+    } else {
+      const sol::error secondary_error = secondary;
+      LOG(ERROR) << secondary_error.what();
+      return std::nullopt;
+    }
+  }
+}
+
+std::optional<sol::protected_function> Program::LoadBytecode(
+    const std::string& bytecode) {
+  const auto chunk =
+      lua.load(std::string_view(bytecode), "=fsmc", sol::load_mode::binary);
+  if (!chunk.valid()) {
+    const sol::error err = chunk;
+    LOG(ERROR) << err.what();
+    return std::nullopt;
+  }
+  return chunk.get<sol::protected_function>();
+}
+
+std::vector<std::string> Program::DumpGuards() const {
+  std::vector<std::string> bytecode(guards.size());
+  for (size_t e = 0; e < guards.size(); ++e) {
+    if (guards[e].valid())
+      bytecode[e] = std::string(guards[e].dump().as_string_view());
+  }
+  return bytecode;
+}
+
+std::vector<std::string> Program::DumpActions() const {
+  std::vector<std::string> bytecode;
+  bytecode.reserve(actions.size());
+  for (const auto& action : actions) {
+    bytecode.emplace_back(action.dump().as_string_view());
+  }
+  return bytecode;
+}
+
+std::vector<std::string> Program::DumpDispatchers() const {
+  std::vector<std::string> bytecode(dispatchChunks.size());
+  for (size_t i = 0; i < dispatchChunks.size(); ++i) {
+    if (dispatchChunks[i].valid())
+      bytecode[i] = std::string(dispatchChunks[i].dump().as_string_view());
+  }
+  return bytecode;
+}
+
+std::string Program::DispatchSource(const EdgeRange range) const {
+  const auto& automat = *definition;
+  // Podmínky s příkazy (return) dostanou vlastní funkci, výrazy se vloží
+  // přímo; _ENV je parametr, takže chunk sdílí všechny instance
+  std::string helpers;
+  std::string chain;
+  for (const auto edge : automat.Order(range)) {
+    const auto& source = automat.guardSources[edge];
+    std::string test = "true";
+    if (automat.edges[edge].guarded && !source.empty()) {
+      if (Utils::Contains(source, "return")) {
+        helpers += absl::StrFormat("local g%d = function(_ENV) %s\nend\n", edge,
+                                   BindSlots(source, automat));
+        test = absl::StrFormat("g%d(_ENV)", edge);
+      } else {
+        test = "(" + BindSlots(source, automat) + "\n)";
+      }
+    }
+    chain += absl::StrFormat("%s %s then return %d\n",
+                             chain.empty() ? "if" : "elseif", test, edge);
+    if (test == "true")
+      break;
+  }
+  return helpers + "return function(_ENV)\n" + chain + "end\nend\n";
+}
+
+void Program::PrepareSwitches() {
+  const auto& automat = *definition;
+  switchAt.assign(automat.order.size(), NoId);
+  if (automat.selection == Selection::EvaluateAll)
+    return;
+
+  std::vector<const GuardLib::Guard*> branches;
+  automat.ForEachSelectionRange([&](const EdgeRange range) {
+    branches.clear();
+    for (const auto e : automat.Order(range)) {
+      if (!automat.edges[e].guarded) {
+        branches.emplace_back(nullptr);
+        break;
+      }
+      if (!nativeGuards[e].has_value())
+        return;
+      branches.emplace_back(&nativeGuards[e].value());
+    }
+    if (auto selection = GuardLib::Switch::Build(branches);
+        selection.has_value()) {
+      switchAt[range.begin] = static_cast<uint32_t>(switches.size());
+      switches.emplace_back(std::move(selection.value()));
+    }
+  });
+}
+
+void Program::PrepareDispatchers() {
+  const auto& automat = *definition;
+  dispatchers.resize(automat.order.size());
+  dispatchChunks.resize(automat.order.size());
+  // Výběrová funkce končí u první platné podmínky
+  if (automat.selection == Selection::EvaluateAll)
+    return;
+
+  const auto prepare = [this, &automat](const EdgeRange range) {
+    if (range.size() < 2)
+      return;
+    std::optional<sol::protected_function> chunk;
+    if (!automat.dispatchBytecode.empty()) {
+      if (automat.dispatchBytecode[range.begin].empty())
+        return;
+      chunk = LoadBytecode(automat.dispatchBytecode[range.begin]);
+    } else {
+      // Interval s jen nativními podmínkami Lua vůbec nevolá
+      const auto order = automat.Order(range);
+      if (automat.guardSources.empty() ||
+          std::none_of(order.begin(), order.end(), [&](const uint32_t e) {
+            return automat.edges[e].guarded && !nativeGuards[e].has_value();
+          }))
+        return;
+      if (auto loaded = lua.load(DispatchSource(range)); loaded.valid())
+        chunk = loaded.get<sol::protected_function>();
+    }
+    if (!chunk.has_value())
+      return;
+
+    // Chyba zde znamená jen pomalejší cestu po jednotlivých podmínkách
+    const auto result = chunk.value()();
+    if (!result.valid())
+      return;
+    const sol::object dispatch = result[0];
+    if (dispatch.get_type() != sol::type::function)
+      return;
+    dispatchers[range.begin] = dispatch.as<sol::protected_function>();
+    dispatchChunks[range.begin] = chunk.value();
+  };
+
+  automat.ForEachSelectionRange(prepare);
+}
+
+void Program::PrepareDependencies() {
+  const auto& automat = *definition;
+  const auto track = [this](const std::string& name) {
+    return trackedVariables
+        .try_emplace(name, static_cast<uint32_t>(trackedVariables.size()))
+        .first->second;
+  };
+
+  std::vector<DependencyLib::Dependencies> guardDeps(automat.edges.size());
+  for (size_t e = 0; e < automat.edges.size(); ++e) {
+    if (!automat.edges[e].guarded)
+      continue;
+    if (automat.guardSources.empty())
+      guardDeps[e].writesAll = true;
+    else
+      guardDeps[e] = DependencyLib::Analyze(automat.guardSources[e], automat);
+  }
+
+  // Výsledek se pamatuje pro celý interval, jen když jsou všechny jeho
+  // podmínky čisté; podmínky s vedlejšími efekty vyžadují EvaluateAll
+  ranges.resize(automat.order.size());
+  automat.ForEachSelectionRange([&](const EdgeRange range) {
+    if (range.empty())
+      return;
+    auto& deps = ranges[range.begin];
+    deps.memoizable = automat.selection == Selection::FirstMatch;
+    for (const auto e : automat.Order(range)) {
+      const auto& guard = guardDeps[e];
+      deps.memoizable &= guard.Memoizable();
+      deps.writes |= guard.writesAll || !guard.writes.empty();
+      deps.allInputs |= guard.allInputs;
+      deps.inputs.insert(deps.inputs.end(), guard.inputs.begin(),
+                         guard.inputs.end());
+      for (const auto& name : guard.reads) {
+        deps.variables.emplace_back(track(name));
+      }
+    }
+    memoized |= deps.memoizable;
+  });
+
+  // Akce zneplatní jen ty pamatované výsledky, jejichž proměnné přiřazuje
+  actionWrites.resize(automat.StateCount());
+  for (size_t s = 0; s < automat.StateCount(); ++s) {
+    auto& writes = actionWrites[s];
+    if (automat.actionSources.empty()) {
+      writes.all = true;  // obraz .fsmc zdroje akcí nenese
+      continue;
+    }
+    const auto deps = DependencyLib::Analyze(automat.actionSources[s], automat);
+    writes.all = deps.writesAll;
+    for (const auto& name : deps.writes) {
+      if (const auto it = trackedVariables.find(name);
+          it != trackedVariables.end())
+        writes.variables.emplace_back(it->second);
+      if (const auto id = automat.VariableId(name); id != NoId)
+        writes.declared.emplace_back(id);
+    }
+  }
+}
+
+std::unique_ptr<Instance> Program::Spawn() {
+  return std::make_unique<Instance>(*this);
+}
+
+namespace {
+
+/// Zpřístupní prostředí instance nativnímu vyhodnocení podmínek
+class InstanceScope final : public GuardLib::Scope {
+ public:
+  InstanceScope(const sol::table& env, const std::vector<sol::reference>& keys,
+                const std::vector<GuardLib::Value>& inputs)
+      : env(env), keys(keys), inputs(inputs) {}
+
+  std::optional<GuardLib::Value> Variable(const uint32_t slot) override {
+    // Klíč je už internovaný Lua řetězec, čtení se obejde bez C++ hashování
+    lua_State* L = env.lua_state();
+    env.push(L);
+    keys[slot].push(L);
+    lua_gettable(L, -2);
+    auto value = StackValue(L, -1);
+    lua_pop(L, 2);
+    return value;
+  }
+
+  const GuardLib::Value& Input(const uint32_t slot) override {
+    return inputs[slot];
+  }
+
+ private:
+  const sol::table& env;
+  const std::vector<sol::reference>& keys;
+  const std::vector<GuardLib::Value>& inputs;
+};
+
+}  // namespace
+
+InterpretedValue Program::InterpretResult(const sol::object& result) {
+  if (result.is<bool>()) {
+    return result.as<bool>();
+  }
+  if (result.is<int>()) {
+    return result.as<int>();
+  }
+  if (result.is<double>()) {
+    return result.as<double>();
+  }
+  if (result.is<std::string>()) {
+    return result.as<std::string>();
+  }
+  if (result.is<sol::table>()) {
+    return std::monostate{};
+  }
+  if (result.is<sol::function>()) {
+    return std::monostate{};
+  }
+  if (result.is<sol::nil_t>()) {
+    return std::monostate{};
+  }
+  LOG(ERROR) << "Unknown result type";
+  throw Utils::ProgramTermination();
+}
+
+bool Program::ExtractBool(const sol::protected_function_result& result) {
+  if (!result.valid()) {
+    const sol::error r_error = result;
+    LOG(ERROR) << absl::StrFormat("Lua runtime error during function call: %v",
+                                  r_error.what());
+    return false;
+  }
+
+  const auto ret = result[0];
+  const auto val_type = ret.get_type();
+
+  if (val_type == sol::type::nil) {
+    return false;
+  }
+  if (val_type == sol::type::boolean) {
+    return ret.get<bool>();
+  }
+  //? Anything that isn't 'nil' or 'false' is automatically true
+  return true;
+}
+
+Instance::Instance(Program& owner)
+    : program(&owner),
+      inputs(owner.Automat().SignalCount()),
+      outputs(owner.Automat().outputNames.size(), std::string()),
+      inputEpochs(owner.Automat().SignalCount()),
+      variableEpochs(owner.trackedVariables.size()),
+      memos(owner.memoized ? owner.Automat().order.size() : 0),
+      timer(owner.clock) {
+  env = owner.lua.create_table();
+  env[sol::metatable_key] = owner.meta;
+  for (const auto& [name, value] : owner.initial) {
+    env[name] = value;
+  }
+  const auto& automat = owner.Automat();
+  // Typovaný vstup začíná nulou svého typu, aby šel porovnat s číslem
+  for (uint32_t signal = 0; signal < inputs.size(); ++signal) {
+    inputs[signal] = automat.SignalDefault(signal);
+  }
+  variables.assign(automat.variableValues.begin(),
+                   automat.variableValues.end());
+  dirty.assign(variables.size(), false);
+}
+
+void Instance::Sync(const uint32_t variable) {
+  lua_State* L = env.lua_state();
+  env.push(L);
+  program->variableNames[variable].push(L);
+  // rawget: proměnná smazaná akcí nesmí číst globální tabulku
+  lua_rawget(L, -2);
+  auto value = StackValue(L, -1).value_or(GuardLib::Value{});
+  lua_pop(L, 2);
+
+  if (value == variables[variable])
+    return;
+  variables[variable] = std::move(value);
+  if (!dirty[variable]) {
+    dirty[variable] = true;
+    changed.push_back(variable);
+  }
+}
+
+void Instance::SyncAll() {
+  for (uint32_t v = 0; v < variables.size(); ++v) {
+    Sync(v);
+  }
+}
+
+std::vector<uint32_t> Instance::TakeChanges() {
+  for (const auto variable : changed) {
+    dirty[variable] = false;
+  }
+  return std::exchange(changed, {});
+}
+
+bool Instance::GuardHolds(const uint32_t edge) {
+  if (!program->Automat().edges[edge].guarded)
+    return true;
+
+  if (const auto& native = program->nativeGuards[edge]; native.has_value()) {
+    InstanceScope scope(env, program->variableKeys, inputs);
+    if (const auto holds = native->Evaluate(scope); holds.has_value()) {
+      if (program->checkGuards && LuaGuardHolds(edge) != holds.value()) {
+        LOG(ERROR) << absl::StrFormat(
+            "Condition [%s]: native evaluation gives %v, Lua gives %v",
+            program->Automat().guardSources[edge], holds.value(),
+            !holds.value());
+        throw Utils::ProgramTermination();
+      }
+      return holds.value();
+    }
+  }
+  return LuaGuardHolds(edge);
+}
+
+bool Instance::LuaGuardHolds(const uint32_t edge) {
+  program->current = this;
+  const auto result = program->guards[edge](env);
+  if (!result.valid()) {
+    const sol::error err = result;
+    LOG(ERROR) << err.what();
+    throw Utils::ProgramTermination();
+  }
+  return Program::ExtractBool(result);
+}
+
+uint32_t Instance::LuaSelect(const EdgeRange range) {
+  const auto& automat = program->Automat();
+  for (const auto edge : automat.Order(range)) {
+    if (!automat.edges[edge].guarded || LuaGuardHolds(edge))
+      return edge;
+  }
+  return NoId;
+}
+
+uint32_t Instance::Select(const EdgeRange range) {
+  if (range.empty())
+    return NoId;
+  // Pamatuje se přechod řádku, cíl se liší podle stavu
+  const auto target = [this](const uint32_t edge) {
+    return edge == NoId ? NoId : program->Automat().Target(state, edge);
+  };
+  const auto& deps = program->ranges[range.begin];
+  if (memos.empty()) {
+    const auto next = Evaluate(range);
+    if (deps.writes)
+      SyncAll();
+    return target(next);
+  }
+
+  auto& memo = memos[range.begin];
+  if (deps.memoizable && Fresh(deps, memo))
+    return target(memo.edge);
+
+  const auto at = epoch;
+  const auto next = Evaluate(range);
+  if (deps.memoizable)
+    memo = {at, next, true};
+  else if (deps.writes)
+    variablesEpoch = ++epoch;
+  if (deps.writes)
+    SyncAll();
+  return target(next);
+}
+
+bool Instance::Fresh(const Program::RangeDependencies& deps,
+                     const Memo& memo) const {
+  if (!memo.valid)
+    return false;
+  const auto changed = [&memo](const uint64_t at) { return at > memo.epoch; };
+  if (deps.allInputs ? changed(inputsEpoch)
+                     : std::any_of(deps.inputs.begin(), deps.inputs.end(),
+                                   [&](const uint32_t signal) {
+                                     return changed(inputEpochs[signal]);
+                                   }))
+    return false;
+  if (!deps.variables.empty() && changed(variablesEpoch))
+    return false;
+  return std::none_of(deps.variables.begin(), deps.variables.end(),
+                      [&](const uint32_t variable) {
+                        return changed(variableEpochs[variable]);
+                      });
+}
+
+void Instance::TouchInput(const uint32_t signal) {
+  inputEpochs[signal] = inputsEpoch = ++epoch;
+}
+
+uint32_t Instance::Evaluate(const EdgeRange range) {
+  const auto& automat = program->Automat();
+  if (automat.selection == Selection::EvaluateAll) {
+    // Všechny podmínky se vyhodnotí, vybere se první platná
+    auto next = NoId;
+    for (const auto edge : automat.Order(range)) {
+      if (GuardHolds(edge) && next == NoId)
+        next = edge;
+    }
+    return next;
+  }
+
+  // Větev podle hodnoty jednoho vstupu bez vyhodnocení podmínek
+  if (const auto at = program->switchAt[range.begin]; at != NoId) {
+    const auto& selection = program->switches[at];
+    if (const auto branch = selection.Select(inputs[selection.Input()]);
+        branch.has_value()) {
+      const auto edge = branch.value() == GuardLib::NoSlot
+                            ? NoId
+                            : automat.order[range.begin + branch.value()];
+      if (program->checkGuards) {
+        if (const auto lua = LuaSelect(range); lua != edge) {
+          // NoId se vypisuje jako -1
+          LOG(ERROR) << absl::StrFormat(
+              "State %s: input switch selects transition %d, Lua conditions "
+              "select %d",
+              StateName(), static_cast<int32_t>(edge),
+              static_cast<int32_t>(lua));
+          throw Utils::ProgramTermination();
+        }
+      }
+      return edge;
+    }
+  }
+
+  // Celý interval jedním voláním výběrové funkce
+  if (const auto& dispatch = program->dispatchers[range.begin];
+      dispatch.valid()) {
+    program->current = this;
+    const auto result = dispatch(env);
+    if (!result.valid()) {
+      const sol::error err = result;
+      LOG(ERROR) << err.what();
+      throw Utils::ProgramTermination();
+    }
+    const sol::object edge = result[0];
+    if (edge.get_type() != sol::type::number)
+      return NoId;
+    return edge.as<uint32_t>();
+  }
+
+  for (const auto edge : automat.Order(range)) {
+    if (GuardHolds(edge))
+      return edge;
+  }
+  return NoId;
+}
+
+void Instance::Enter(const uint32_t target) {
+  state = target;
+  if (program->onEnter)
+    program->onEnter(*this, target);
+
+  program->current = this;
+  const auto result = program->actions[target](env);
+  if (!result.valid()) {
+    const sol::error err = result;
+    LOG(ERROR) << err.what();
+    throw Utils::ProgramTermination();
+  }
+
+  // Akce mohla přepsat proměnné, které čtou pamatované podmínky
+  const auto& writes = program->actionWrites[target];
+  if (writes.all)
+    variablesEpoch = ++epoch;
+  for (const auto variable : writes.variables) {
+    variableEpochs[variable] = ++epoch;
+  }
+  if (writes.all)
+    SyncAll();
+  for (const auto variable : writes.declared) {
+    Sync(variable);
+  }
+
+  const auto value = Program::InterpretResult(sol::object(result[0]));
+  if (std::holds_alternative<std::monostate>(value)) {
+    LOG(ERROR) << "Result interpretation failed";
+    throw Utils::ProgramTermination();
+  }
+  if (program->onOutput)
+    program->onOutput(*this, value);
+}
+
+void Instance::SetInput(const std::string& name, const std::string& value) {
+  const auto& automat = program->Automat();
+  const auto id = automat.SignalId(name);
+  if (id == NoId)
+    return;
+  auto typed = automat.SignalValue(id, value);
+  if (!typed.has_value()) {
+    LOG(ERROR) << absl::StrFormat("Invalid value of input %s: %s", name,
+                                  value);
+    throw Utils::ProgramTermination();
+  }
+  SetInput(id, std::move(typed.value()));
+}
+
+void Instance::SetInput(const uint32_t signal, GuardLib::Value value) {
+  auto& slot = inputs[signal];
+  if (slot == value)
+    return;
+  slot = std::move(value);
+  TouchInput(signal);
+}
+
+void Instance::Schedule(const EdgeRange range, const Clock::time_point from) {
+  program->Automat().ForEachDelayGroup(
+      range, [&](const Edge& edge, const EdgeRange group) {
+        Pending p{from + std::chrono::milliseconds(edge.delay), group};
+        // Opakovaný vstup odpočet skupiny restartuje, nepřidává další termín
+        pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                     [&group](const Pending& other) {
+                                       return other.group.begin ==
+                                                  group.begin &&
+                                              other.group.end == group.end;
+                                     }),
+                      pending.end());
+        const auto at = std::upper_bound(
+            pending.begin(), pending.end(), p.deadline,
+            [](const Clock::time_point t, const Pending& other) {
+              return t < other.deadline;
+            });
+        pending.insert(at, p);
+      });
+}
+
+Step Instance::Settle(const Clock::time_point now) {
+  started = true;
+  pending.clear();
+  while (true) {
+    const auto& plan = Plan();
+    if (plan.free.empty() && plan.timers.empty() && plan.buckets.empty()) {
+      LOG(ERROR) << "No transitions for state: " << StateName();
+      return Step::Halted;
+    }
+    if (plan.free.empty())
+      break;
+
+    // Řetěz nepodmíněných přechodů bez výběru, akce stavů běží po řadě
+    if (program->jumps[state] != NoId) {
+      for (auto next = program->jumps[state]; next != NoId;
+           next = program->jumps[next]) {
+        Enter(next);
+      }
+      continue;
+    }
+
+    const auto next = Select(plan.free);
+    if (next == NoId) {
+      LOG(ERROR) << "No next state found, but expected one";
+      throw Utils::ProgramTermination();
+    }
+    Enter(next);
+  }
+
+  Schedule(Plan().timers, now);
+  return Step::Moved;
+}
+
+Step Instance::Input(const std::string& name, const std::string& value,
+                     const Clock::time_point now) {
+  const auto signal = program->Automat().SignalId(name);
+  if (signal == NoId)
+    return Step::Idle;
+  SetInput(name, value);
+  return Trigger(signal, now);
+}
+
+Step Instance::Input(const uint32_t signal, GuardLib::Value value,
+                     const Clock::time_point now) {
+  SetInput(signal, std::move(value));
+  return Trigger(signal, now);
+}
+
+Step Instance::Input(InputFrame frame, const Clock::time_point now) {
+  for (auto& [signal, value] : frame) {
+    SetInput(signal, std::move(value));
+  }
+  for (auto it = frame.begin(); it != frame.end(); ++it) {
+    const auto signal = it->first;
+    // Signál zadaný ve snímku víckrát se vyhodnotí jen jednou
+    if (std::any_of(frame.begin(), it, [signal](const auto& input) {
+          return input.first == signal;
+        }))
+      continue;
+    if (const auto step = Trigger(signal, now); step != Step::Idle)
+      return step;
+  }
+  return Step::Idle;
+}
+
+Step Instance::Trigger(const std::string& name, const Clock::time_point now) {
+  return Trigger(program->Automat().SignalId(name), now);
+}
+
+Step Instance::Trigger(const uint32_t signal, const Clock::time_point now) {
+  if (signal == NoId)
+    return Step::Idle;
+  const auto* bucket = program->Automat().FindBucket(Plan(), signal);
+  if (bucket == nullptr)
+    return Step::Idle;
+
+  if (const auto next = Select(bucket->untimed); next != NoId) {
+    Enter(next);
+    return Settle(now);
+  }
+
+  // Časované vstupní přechody se odpočítávají od příchodu vstupu
+  Schedule(bucket->timed, now);
+  return Step::Idle;
+}
+
+Step Instance::Expire(const Clock::time_point now) {
+  auto next = NoId;
+  auto at = now;
+  while (next == NoId && !pending.empty() && pending.front().deadline <= now) {
+    const auto group = pending.front().group;
+    at = pending.front().deadline;
+    pending.erase(pending.begin());
+    next = Select(group);
+  }
+  if (next == NoId)
+    return Step::Idle;
+
+  Enter(next);
+  // Časovače nového stavu běží od termínu, ne od okamžiku zpracování
+  return Settle(at);
+}
+
+std::optional<Clock::time_point> Instance::NextDeadline() const {
+  if (pending.empty())
+    return std::nullopt;
+  return pending.front().deadline;
+}
+
+}  // namespace Runtime
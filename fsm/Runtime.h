@@ -0,0 +1,431 @@
+/**
+ * @file   Runtime.h
+ * @brief  Deklaruje běhové prostředí pro mnoho instancí jednoho automatu.
+ * @details
+ * Program vlastní Lua stav a jednou přeložené chunky podmínek a akcí sdílené
+ * definice (CompiledAutomat). Instance nese jen to, co je pro jeden běh
+ * automatu vlastní: aktuální stav, proměnné, vstupy, výstupy a časovače.
+ * Chunky se volají s prostředím instance jako argumentem (local _ENV = ...),
+ * takže jedna Lua VM obslouží libovolný počet instancí.
+ *
+ * Vstupy a výstupy leží v polích instance indexovaných id signálu. Volání
+ * valueof("x"), defined("x") a output("x", ...) s deklarovaným jménem se při
+ * překladu chunku přepíšou na __valueof(id) apod., takže za běhu nehledají
+ * podle jména.
+ * @date   2025-05-11
+ */
+#pragma once
+
+#include <absl/container/flat_hash_map.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "GuardLib.h"
+#include "Stopwatch.h"
+#include "external/sol.hpp"
+#include "types/all_types.h"
+
+namespace Runtime {
+using namespace types;
+
+/// Neměnná přeložená definice sdílená všemi instancemi (i mezi vlákny)
+using Definition = std::shared_ptr<const CompiledAutomat>;
+
+using Clock = std::chrono::steady_clock;
+
+using InterpretedValue =
+    std::variant<std::monostate, bool, int, double, std::string>;
+
+/// Výsledek zpracování události instancí
+enum class Step {
+  Idle,   /**< Instance zůstala v aktuálním stavu */
+  Moved,  /**< Proběhl přechod a nový stav je ustálený */
+  Halted  /**< Stav nemá žádné přechody, běh instance skončil */
+};
+
+class Instance;
+
+/**
+ * @class Program
+ * @brief Lua VM s přeloženými chunky jedné definice.
+ */
+class Program {
+  /// @attention 'lua' musí být deklarován jako první, protože všechny
+  /// sol::protected_function a sol::table níže (i v instancích) na něj
+  /// odkazují a musí být zničeny dříve než samotný Lua stav.
+  sol::state lua{};
+
+  Definition definition;
+
+  /// Sdílená metatabulka prostředí instancí (__index = _G)
+  sol::table meta{};
+
+  /// Podmínky hran indexované stejně jako CompiledAutomat::edges
+  std::vector<sol::protected_function> guards{};
+
+  /// Nativně přeložené podmínky (nullopt = jen Lua chunk)
+  std::vector<std::optional<GuardLib::Guard>> nativeGuards{};
+
+  /// Výběrové funkce (if/elseif přes podmínky intervalu) po začátku
+  /// intervalu v CompiledAutomat::order; neplatná = podmínky po jedné
+  std::vector<sol::protected_function> dispatchers{};
+
+  /// Chunky, které výběrové funkce vytvoří (pro DumpDispatchers)
+  std::vector<sol::protected_function> dispatchChunks{};
+
+  /// Index do switches po začátku intervalu v CompiledAutomat::order
+  /// (NoId = interval se vyhodnocuje po podmínkách)
+  std::vector<uint32_t> switchAt{};
+
+  /// Výběry intervalů, jejichž podmínky porovnávají jeden vstup s konstantami
+  std::vector<GuardLib::Switch> switches{};
+
+  /// Závislosti intervalu výběru na vstupech a proměnných
+  struct RangeDependencies {
+    bool memoizable = false; /**< Výsledek výběru lze pamatovat */
+    bool writes = false;     /**< Některá podmínka může zapsat proměnné */
+    bool allInputs = false;  /**< Čte vstup, jehož jméno není konstanta */
+    std::vector<uint32_t> inputs{};    /**< Id čtených vstupů */
+    std::vector<uint32_t> variables{}; /**< Čtené sledované proměnné */
+  };
+
+  /// Proměnné přiřazované akcí stavu
+  struct ActionWrites {
+    bool all = false; /**< Akce může zapsat libovolnou proměnnou */
+    std::vector<uint32_t> variables{};
+    std::vector<uint32_t> declared{}; /**< Id deklarovaných proměnných */
+  };
+
+  /// Proměnné čtené podmínkami -> index verze v instanci
+  absl::flat_hash_map<std::string, uint32_t> trackedVariables{};
+
+  /// Závislosti po začátku intervalu v CompiledAutomat::order
+  std::vector<RangeDependencies> ranges{};
+
+  /// Zápisy akcí indexované id stavu
+  std::vector<ActionWrites> actionWrites{};
+
+  /// Některý interval lze pamatovat (instance alokují memo)
+  bool memoized = false;
+
+  /// Akce stavů indexované id stavu
+  std::vector<sol::protected_function> actions{};
+
+  /// Cíl volného přechodu, který se ze stavu provede vždy (NoId = výběr)
+  std::vector<uint32_t> jumps{};
+
+  /// Počáteční hodnoty proměnných převedené na Lua hodnoty
+  std::vector<std::pair<std::string, sol::object>> initial{};
+
+  /// Jména deklarovaných proměnných jako Lua řetězce, po id proměnné
+  std::vector<sol::reference> variableNames{};
+
+  /// Klíče proměnných (Lua řetězce) po slotech nativních podmínek
+  std::vector<sol::reference> variableKeys{};
+
+  /// Instance, jejíž chunk se právě vykonává (pro valueof/defined/output)
+  Instance* current = nullptr;
+
+  /// Zdroj času pro elapsed(); nullptr = skutečné hodiny
+  const ClockSource<Clock>* clock = nullptr;
+
+  friend class Instance;
+
+  void PrepareHelpers();
+
+  /**
+   * @brief Najde řetězy nepodmíněných volných přechodů a odmítne cykly.
+   */
+  void PrepareJumps();
+
+  /**
+   * @brief Zaregistruje C funkci s Programem jako upvalue.
+   */
+  void Register(const char* name, lua_CFunction function);
+
+  static int ValueOf(lua_State* L);
+  static int Defined(lua_State* L);
+  static int Output(lua_State* L);
+  static int InputByName(lua_State* L);
+  static int DefinedByName(lua_State* L);
+  static int OutputByName(lua_State* L);
+  static int InputsIndex(lua_State* L);
+  static int InputsNewIndex(lua_State* L);
+  static int OutputsIndex(lua_State* L);
+  static int OutputsNewIndex(lua_State* L);
+
+  /**
+   * @brief Připraví počáteční hodnoty proměnných z hodnot převedených při
+   * překladu.
+   */
+  void PrepareVariables();
+  void PrepareStates();
+
+  /**
+   * @brief Přeloží podmínky přechodů.
+   */
+  void PrepareTransitions();
+
+  /**
+   * @brief Sloučí podmínky intervalů nad jedním vstupem do GuardLib::Switch.
+   */
+  void PrepareSwitches();
+
+  /**
+   * @brief Připraví výběrové funkce intervalů, jejichž podmínky nejdou
+   * vyhodnotit nativně.
+   */
+  void PrepareDispatchers();
+
+  /**
+   * @brief Zjistí, co podmínky intervalů čtou a co akce zapisují.
+   */
+  void PrepareDependencies();
+
+  /**
+   * @brief Vygeneruje Lua chunk vracející výběrovou funkci intervalu.
+   */
+  [[nodiscard]] std::string DispatchSource(EdgeRange range) const;
+
+  std::optional<sol::protected_function> TestAndSet(const std::string& _cond);
+
+  /**
+   * @brief Načte chunk z předpřeloženého bytecode (bez překladu).
+   */
+  std::optional<sol::protected_function> LoadBytecode(
+      const std::string& bytecode);
+
+ public:
+  /// Volá se při vstupu do stavu (před vykonáním jeho akce)
+  std::function<void(Instance&, uint32_t)> onEnter{};
+
+  /// Volá se s výsledkem akce stavu
+  std::function<void(Instance&, const InterpretedValue&)> onOutput{};
+
+  /// Nativní podmínky a větvení vstupů se ověřují i v Lua (--check-guards);
+  /// rozdílný výsledek ukončí program
+  bool checkGuards = false;
+
+  /**
+   * @param definition Sdílená přeložená definice.
+   * @param clock      Zdroj času instancí (nullptr = Clock::now()); musí
+   *                   žít déle než Program.
+   */
+  explicit Program(Definition definition,
+                   const ClockSource<Clock>* clock = nullptr);
+
+  Program(const Program&) = delete;
+  Program& operator=(const Program&) = delete;
+
+  [[nodiscard]] const CompiledAutomat& Automat() const { return *definition; }
+  [[nodiscard]] const Definition& Shared() const { return definition; }
+
+  /// Aktuální čas podle zdroje času Programu
+  [[nodiscard]] Clock::time_point Now() const {
+    return clock ? clock->now() : Clock::now();
+  }
+
+  /**
+   * @brief Vytvoří novou instanci v počátečním stavu.
+   * @attention Instance musí být zničena dříve než Program.
+   */
+  std::unique_ptr<Instance> Spawn();
+
+  /**
+   * @brief Vrátí bytecode (lua_dump) podmínek po hranách ("" = bez podmínky).
+   */
+  [[nodiscard]] std::vector<std::string> DumpGuards() const;
+
+  /**
+   * @brief Vrátí bytecode (lua_dump) akcí po stavech.
+   */
+  [[nodiscard]] std::vector<std::string> DumpActions() const;
+
+  /**
+   * @brief Vrátí bytecode chunků výběrových funkcí po pozicích v order.
+   */
+  [[nodiscard]] std::vector<std::string> DumpDispatchers() const;
+
+  static InterpretedValue InterpretResult(const sol::object& result);
+  static bool ExtractBool(const sol::protected_function_result& result);
+};
+
+/**
+ * @class Instance
+ * @brief Jeden běh automatu nad sdíleným Programem.
+ */
+class Instance {
+ public:
+  explicit Instance(Program& program);
+
+  [[nodiscard]] uint32_t State() const { return state; }
+  [[nodiscard]] const StatePlan& Plan() const {
+    return program->Automat().PlanOf(state);
+  }
+  [[nodiscard]] const std::string& StateName() const {
+    return program->Automat().stateNames[state];
+  }
+
+  /**
+   * @brief Vyhodnotí podmínky přechodů v intervalu plánu podle
+   * CompiledAutomat::selection.
+   * @details Výsledek intervalu s čistými podmínkami se pamatuje, dokud se
+   * nezmění žádný vstup ani proměnná, které podmínky čtou.
+   * @return Id cílového stavu prvního platného přechodu nebo NoId.
+   */
+  uint32_t Select(EdgeRange range);
+
+  /**
+   * @brief Přejde do stavu a vykoná jeho akci (bez plánování časovačů).
+   */
+  void Enter(uint32_t target);
+
+  /**
+   * @brief Zapíše hodnotu vstupního signálu; nedeklarované jméno ignoruje.
+   * @details Text se převede podle deklarovaného typu vstupu.
+   */
+  void SetInput(const std::string& name, const std::string& value);
+
+  /**
+   * @brief Zapíše už převedenou hodnotu vstupního signálu podle id.
+   * @details Zápis stejné hodnoty pamatované výsledky nezneplatní.
+   */
+  void SetInput(uint32_t signal, GuardLib::Value value);
+
+  /**
+   * @brief Hodnota výstupu podle id (monostate = nil).
+   */
+  [[nodiscard]] const GuardLib::Value& OutputValue(uint32_t output) const {
+    return outputs[output];
+  }
+
+  /**
+   * @brief Hodnota deklarované proměnné podle id (monostate = nil nebo
+   * hodnota, kterou nelze vyjádřit jako Value).
+   */
+  [[nodiscard]] const GuardLib::Value& VariableValue(uint32_t variable) const {
+    return variables[variable];
+  }
+
+  /**
+   * @brief Vrátí id deklarovaných proměnných změněných od posledního volání.
+   * @details Publikování nebo ukládání stavu tak stojí úměrně počtu změn,
+   * ne počtu proměnných.
+   */
+  std::vector<uint32_t> TakeChanges();
+
+  /**
+   * @brief Projde volné přechody aktivního stavu a naplánuje jeho časovače.
+   * @param now Okamžik vstupu do stavu.
+   */
+  Step Settle(Clock::time_point now);
+
+  /**
+   * @brief Zpracuje vstup; přechod na vstup zruší čekající časovače.
+   */
+  Step Input(const std::string& name, const std::string& value,
+             Clock::time_point now);
+
+  /**
+   * @brief Zpracuje vstup podle id signálu (jméno i hodnota převedené už
+   * při čtení, viz CompiledAutomat::SignalValue).
+   */
+  Step Input(uint32_t signal, GuardLib::Value value, Clock::time_point now);
+
+  /**
+   * @brief Zpracuje snímek vstupů jako jednu událost.
+   * @details Nejdřív zapíše všechny hodnoty, teprve pak zkouší přechody
+   * signálů snímku v pořadí; první, který instanci posune, vyhrává a zbylé
+   * signály už jen nesou hodnotu. Nevznikají tak mezilehlé přechody podle
+   * napůl zapsaného snímku.
+   */
+  Step Input(InputFrame frame, Clock::time_point now);
+
+  /**
+   * @brief Zpracuje vstup, jehož hodnota už byla zapsána přes SetInput.
+   */
+  Step Trigger(const std::string& name, Clock::time_point now);
+
+  /**
+   * @brief Zpracuje vstup podle id signálu; NoId se ignoruje.
+   */
+  Step Trigger(uint32_t signal, Clock::time_point now);
+
+  /**
+   * @brief Zpracuje časovače, jejichž termín už uplynul.
+   */
+  Step Expire(Clock::time_point now);
+
+  /**
+   * @brief Nejbližší termín čekajícího časovače.
+   */
+  [[nodiscard]] std::optional<Clock::time_point> NextDeadline() const;
+
+  /**
+   * @brief Zda aktivní stav čeká na nějaký vstup.
+   */
+  [[nodiscard]] bool AcceptsInput() const { return !Plan().buckets.empty(); }
+
+  /**
+   * @brief Zda už proběhl první Settle (instance opustila počáteční stav).
+   */
+  [[nodiscard]] bool Started() const { return started; }
+
+ private:
+  /// Naplánovaná skupina časovaných přechodů se stejným termínem
+  struct Pending {
+    Clock::time_point deadline;
+    EdgeRange group;
+  };
+
+  /// Pamatovaný výsledek výběru z intervalu
+  struct Memo {
+    uint64_t epoch = 0; /**< Hodnota 'epoch' v okamžiku vyhodnocení */
+    uint32_t edge = NoId; /**< Vybraný přechod řádku (sdílí ho více stavů) */
+    bool valid = false;
+  };
+
+  bool GuardHolds(uint32_t edge);
+  /// Vyhodnotí podmínku přechodu Lua chunkem (bez nativní cesty)
+  bool LuaGuardHolds(uint32_t edge);
+  /// První přechod intervalu, jehož Lua podmínka platí (pro --check-guards)
+  uint32_t LuaSelect(EdgeRange range);
+  /// Vybere přechod z intervalu; vrací index do edges nebo NoId
+  uint32_t Evaluate(EdgeRange range);
+  [[nodiscard]] bool Fresh(const Program::RangeDependencies& deps,
+                           const Memo& memo) const;
+  void TouchInput(uint32_t signal);
+  /// Převezme hodnotu deklarované proměnné z env a označí ji při změně
+  void Sync(uint32_t variable);
+  void SyncAll();
+  void Schedule(EdgeRange range, Clock::time_point from);
+
+  Program* program;
+  sol::table env{}; /**< Prostředí chunků: proměnné */
+  std::vector<GuardLib::Value> inputs;  /**< Hodnoty vstupů po id signálu */
+  std::vector<GuardLib::Value> outputs; /**< Hodnoty výstupů po id výstupu */
+  std::vector<GuardLib::Value> variables; /**< Deklarované proměnné po id */
+  std::vector<bool> dirty;        /**< Proměnná je v 'changed' */
+  std::vector<uint32_t> changed;  /**< Změněné proměnné od TakeChanges */
+  uint64_t epoch = 0;          /**< Počítadlo zápisů sledovaných hodnot */
+  uint64_t inputsEpoch = 0;    /**< Poslední změna libovolného vstupu */
+  uint64_t variablesEpoch = 0; /**< Poslední zápis libovolné proměnné */
+  std::vector<uint64_t> inputEpochs;    /**< Poslední změna po id signálu */
+  std::vector<uint64_t> variableEpochs; /**< Poslední zápis sledované proměnné */
+  std::vector<Memo> memos; /**< Po začátku intervalu v order (nebo prázdné) */
+  uint32_t state = 0;
+  bool started = false;
+  /// Seřazeno podle deadline, každá skupina nejvýš jednou
+  std::vector<Pending> pending{};
+  Timer<> timer;                  /**< Měří elapsed() od vytvoření */
+
+  friend class Program;
+};
+
+}  // namespace Runtime
@@ -0,0 +1,305 @@
+#include "Scheduler.h"
+
+#include <absl/log/log.h>
+
+#include <algorithm>
+#include <iterator>
+
+#include "Utils.h"
+
+namespace Scheduler {
+
+Fleet::Fleet(Runtime::Definition definition, const size_t workers)
+    : definition(std::move(definition)) {
+  const auto count = std::max<size_t>(workers, 1);
+  this->workers.reserve(count);
+  for (size_t w = 0; w < count; ++w) {
+    auto worker = std::make_unique<Worker>();
+    worker->program = std::make_unique<Runtime::Program>(this->definition);
+
+    auto* raw = worker.get();
+    worker->program->onEnter = [this, raw](const Runtime::Instance& instance,
+                                           uint32_t) {
+      if (onEnter)
+        onEnter(raw->running, instance.StateName());
+    };
+    worker->program->onOutput = [this, raw](Runtime::Instance&,
+                                            const Runtime::InterpretedValue&
+                                                value) {
+      if (onOutput)
+        onOutput(raw->running, value);
+    };
+    this->workers.push_back(std::move(worker));
+  }
+}
+
+Fleet::~Fleet() {
+  Stop();
+  for (auto& worker : workers) {
+    if (worker->thread.joinable())
+      worker->thread.join();
+  }
+  // Instance musí zmizet dříve než Lua VM, ve které žijí
+  slots.clear();
+}
+
+void Fleet::CheckGuards() {
+  for (auto& worker : workers) {
+    worker->program->checkGuards = true;
+  }
+}
+
+size_t Fleet::Spawn() {
+  const auto id = slots.size();
+  const auto owner = id % workers.size();
+
+  auto& slot = slots.emplace_back();
+  slot.owner = owner;
+  slot.instance = workers[owner]->program->Spawn();
+  // Nová instance musí projít volnými přechody a naplánovat časovače
+  Enqueue(id);
+  return id;
+}
+
+void Fleet::Post(const size_t id, const types::InputFrame& frame) {
+  auto& slot = slots[id];
+  {
+    std::lock_guard lock(slot.inboxMutex);
+    slot.inbox.insert(slot.inbox.end(), frame.begin(), frame.end());
+  }
+  Enqueue(id);
+}
+
+void Fleet::Broadcast(const types::InputFrame& frame) {
+  for (size_t id = 0; id < slots.size(); ++id) {
+    Post(id, frame);
+  }
+}
+
+void Fleet::Start() {
+  for (size_t w = 0; w < workers.size(); ++w) {
+    workers[w]->thread = std::thread([this, w] { Loop(w); });
+  }
+}
+
+void Fleet::CloseInput() {
+  inputClosed = true;
+  Notify();
+}
+
+void Fleet::Stop() {
+  stopping = true;
+  {
+    std::lock_guard lock(wakeMutex);
+    wakeCv.notify_all();
+  }
+  Notify();
+}
+
+void Fleet::Wait() {
+  std::unique_lock lock(doneMutex);
+  doneCv.wait(lock, [this] { return Done(); });
+}
+
+bool Fleet::Done() const {
+  if (stopping || failed || halted == slots.size())
+    return true;
+  return inputClosed && queued == 0 && inFlight == 0 && timed == 0;
+}
+
+void Fleet::Notify() {
+  if (!Done())
+    return;
+  {
+    std::lock_guard lock(doneMutex);
+    doneCv.notify_all();
+  }
+  if (onDone)
+    onDone();
+}
+
+void Fleet::Enqueue(const size_t id) {
+  auto& slot = slots[id];
+  if (slot.queued.exchange(true))
+    return;
+
+  auto& worker = *workers[slot.owner];
+  {
+    std::lock_guard lock(worker.queueMutex);
+    worker.ready.push_back(id);
+    ++worker.depth;
+  }
+  ++queued;
+  if (!slot.pinned)
+    ++stealable;
+
+  // Připnutou instanci vezme jen vlastník, probudit se musí i on
+  std::lock_guard lock(wakeMutex);
+  wakeCv.notify_all();
+}
+
+bool Fleet::Pop(Worker& worker, size_t& id) {
+  std::lock_guard lock(worker.queueMutex);
+  if (worker.ready.empty())
+    return false;
+  id = worker.ready.front();
+  worker.ready.pop_front();
+  --worker.depth;
+  if (!slots[id].pinned)
+    --stealable;
+  // inFlight se zvyšuje dřív, než klesne queued, aby Done() neviděl prázdno
+  ++inFlight;
+  --queued;
+  return true;
+}
+
+bool Fleet::Steal(const size_t self, size_t& id) {
+  for (size_t i = 1; i < workers.size(); ++i) {
+    auto& victim = *workers[(self + i) % workers.size()];
+    std::lock_guard lock(victim.queueMutex);
+    // Krást lze jen instance, které ještě neudělaly první krok
+    const auto found =
+        std::find_if(victim.ready.rbegin(), victim.ready.rend(),
+                     [this](const size_t candidate) {
+                       return !slots[candidate].pinned;
+                     });
+    if (found == victim.ready.rend())
+      continue;
+    id = *found;
+    victim.ready.erase(std::next(found).base());
+    --victim.depth;
+    --stealable;
+    ++inFlight;
+    --queued;
+    return true;
+  }
+  return false;
+}
+
+void Fleet::Adopt(const size_t self, Slot& slot) {
+  auto& me = *workers[self];
+  while (true) {
+    const auto owner = slot.owner.load();
+    if (owner == self)
+      return;
+
+    // Obě VM zamčené najednou, nikdo tak nevidí napůl přestěhovanou instanci
+    std::scoped_lock lock(workers[owner]->vm, me.vm);
+    if (slot.owner != owner)
+      continue;
+
+    // Nespuštěná instance má jen počáteční stav, nová je s ní shodná
+    slot.instance = me.program->Spawn();
+    slot.owner = self;
+    return;
+  }
+}
+
+void Fleet::Step(const size_t self, const size_t id) {
+  auto& me = *workers[self];
+  auto& slot = slots[id];
+
+  std::unique_lock lock(me.vm, std::defer_lock);
+  while (true) {
+    Adopt(self, slot);
+    lock.lock();
+    if (slot.owner == self)
+      break;
+    // Mezitím ji ukradlo jiné vlákno
+    lock.unlock();
+  }
+
+  // Připnout dřív, než Enqueue smí instanci znovu zařadit (počítadlo stealable)
+  slot.pinned = true;
+  slot.queued = false;
+  types::InputFrame inbox;
+  {
+    std::lock_guard inboxLock(slot.inboxMutex);
+    inbox.swap(slot.inbox);
+  }
+  if (slot.halted)
+    return;
+
+  me.running = id;
+  auto& instance = *slot.instance;
+  auto step = Runtime::Step::Idle;
+  if (!instance.Started())
+    step = instance.Settle(Clock::now());
+  // Vše, co přišlo od posledního kroku, se zpracuje jako jeden snímek
+  if (!inbox.empty() && step != Runtime::Step::Halted)
+    step = instance.Input(std::move(inbox), Clock::now());
+  if (step != Runtime::Step::Halted)
+    step = instance.Expire(Clock::now());
+
+  const auto deadline = step == Runtime::Step::Halted
+                            ? std::nullopt
+                            : instance.NextDeadline();
+  // Nezměněný termín už v haldě je, jinak by rostla s každým vstupem
+  if (deadline.has_value() &&
+      (!slot.timed || slot.deadline != deadline.value())) {
+    me.timers.emplace(deadline.value(), id);
+    slot.deadline = deadline.value();
+  }
+
+  if (deadline.has_value() != slot.timed) {
+    slot.timed = deadline.has_value();
+    if (slot.timed)
+      ++timed;
+    else
+      --timed;
+  }
+  if (step == Runtime::Step::Halted) {
+    slot.halted = true;
+    ++halted;
+  }
+}
+
+void Fleet::Loop(const size_t self) {
+  auto& me = *workers[self];
+  try {
+    while (!stopping) {
+      // Vypršené časovače vlastních instancí je zařadí mezi připravené
+      const auto now = Clock::now();
+      while (!me.timers.empty() && me.timers.top().first <= now) {
+        const auto [at, id] = me.timers.top();
+        me.timers.pop();
+        // Záznam nahrazený novějším termínem je zastaralý
+        auto& slot = slots[id];
+        if (slot.owner == self && slot.timed && slot.deadline == at) {
+          // Záznam je spotřebovaný, Step termín vloží znovu i když se nezmění
+          slot.deadline = Clock::time_point::min();
+          Enqueue(id);
+        }
+      }
+
+      size_t id;
+      if (Pop(me, id) || Steal(self, id)) {
+        Step(self, id);
+        --inFlight;
+        Notify();
+        continue;
+      }
+
+      if (onIdle)
+        onIdle();
+      std::unique_lock lock(wakeMutex);
+      // Cizí připnuté instance toto vlákno nevezme, nesmí ho tedy budit
+      const auto wake = [this, &me] {
+        return stopping || me.depth > 0 || stealable > 0;
+      };
+      if (me.timers.empty())
+        wakeCv.wait(lock, wake);
+      else
+        wakeCv.wait_until(lock, me.timers.top().first, wake);
+    }
+  } catch (const Utils::ProgramTermination&) {
+    failed = true;
+    Stop();
+  } catch (const std::exception& e) {
+    LOG(ERROR) << e.what();
+    failed = true;
+    Stop();
+  }
+}
+
+}  // namespace Scheduler
@@ -0,0 +1,193 @@
+/**
+ * @file   Scheduler.h
+ * @brief  Deklaruje work-stealing plánovač pro běh mnoha instancí automatu.
+ * @details
+ * Fleet rozkládá instance jedné přeložené definice mezi pracovní vlákna.
+ * Každé vlákno vlastní Runtime::Program (svou Lua VM) a instance jsou k němu
+ * přiřazeny. Připravená instance (čekající vstup, vypršený časovač nebo první
+ * ustálení po vytvoření) se zařadí do fronty svého vlákna. Nečinné vlákno
+ * může z fronty jiného vlákna ukrást jen dosud nespuštěnou instanci a vytvoří
+ * ji znovu ve své VM; po prvním kroku zůstává instance připnutá ke svému
+ * vláknu (stav Lua VM nelze přenést beze ztrát), další vyvažování už není.
+ * @date   2025-05-11
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Runtime.h"
+
+namespace Scheduler {
+using Runtime::Clock;
+
+/**
+ * @class Fleet
+ * @brief Pool vláken krokující instance sdílené definice.
+ */
+class Fleet {
+ public:
+  /// Vstup instance do stavu; volá se souběžně z pracovních vláken
+  std::function<void(size_t id, const std::string& state)> onEnter{};
+
+  /// Výsledek akce stavu; volá se souběžně z pracovních vláken
+  std::function<void(size_t id, const Runtime::InterpretedValue& value)>
+      onOutput{};
+
+  /// Volá se (z libovolného vlákna), jakmile Done() začne platit
+  std::function<void()> onDone{};
+
+  /// Pracovní vlákno nemá co dělat a usne (konec dávky výstupu)
+  std::function<void()> onIdle{};
+
+  /**
+   * @param definition Sdílená přeložená definice.
+   * @param workers    Počet pracovních vláken (alespoň 1).
+   */
+  Fleet(Runtime::Definition definition, size_t workers);
+  ~Fleet();
+
+  Fleet(const Fleet&) = delete;
+  Fleet& operator=(const Fleet&) = delete;
+
+  /**
+   * @brief Zapne ověřování nativních podmínek v Lua ve všech VM.
+   * @attention Volá se pouze před Start().
+   */
+  void CheckGuards();
+
+  /**
+   * @brief Vytvoří novou instanci a přiřadí ji vláknu (round-robin).
+   * @attention Volá se pouze před Start().
+   * @return Id instance.
+   */
+  size_t Spawn();
+
+  /**
+   * @brief Předá instanci snímek vstupů; lze volat z libovolného vlákna.
+   */
+  void Post(size_t id, const types::InputFrame& frame);
+
+  /**
+   * @brief Předá snímek vstupů všem instancím.
+   */
+  void Broadcast(const types::InputFrame& frame);
+
+  /**
+   * @brief Spustí pracovní vlákna.
+   */
+  void Start();
+
+  /**
+   * @brief Oznámí, že už nepřijdou žádné vstupy.
+   * @details Fleet je pak hotový, jakmile nemá práci ani čekající časovače.
+   */
+  void CloseInput();
+
+  /**
+   * @brief Zastaví pracovní vlákna (rozpracované kroky se dokončí).
+   */
+  void Stop();
+
+  /**
+   * @brief Blokuje, dokud neplatí Done().
+   */
+  void Wait();
+
+  /**
+   * @brief Zda všechny instance skončily, fleet nemá co dělat po uzavření
+   * vstupu, byl zastaven, nebo některý krok selhal.
+   */
+  [[nodiscard]] bool Done() const;
+
+  /**
+   * @brief Zda některý krok instance skončil chybou.
+   */
+  [[nodiscard]] bool Failed() const { return failed.load(); }
+
+  [[nodiscard]] size_t Size() const { return slots.size(); }
+
+ private:
+  /// Instance a její plánovací stav
+  struct Slot {
+    /// Instance žije ve VM vlastníka, přístup jen pod Worker::vm vlastníka
+    std::unique_ptr<Runtime::Instance> instance;
+    std::atomic<size_t> owner{0};    /**< Index vlastnícího vlákna */
+    std::atomic<bool> queued{false}; /**< Zda už je ve frontě některého vlákna */
+    /// Po prvním kroku zůstává instance ve VM vlastníka (nelze ji ukrást)
+    std::atomic<bool> pinned{false};
+    std::mutex inboxMutex;
+    types::InputFrame inbox{};
+    bool halted = false; /**< Pod Worker::vm vlastníka */
+    bool timed = false;  /**< Pod Worker::vm vlastníka */
+    /// Platný termín časovače (když 'timed'); starší záznamy v timers se
+    /// při vyjmutí zahodí. Jen vlastnící vlákno (instance je připnutá).
+    Clock::time_point deadline{};
+  };
+
+  /// Pracovní vlákno s vlastní Lua VM
+  struct Worker {
+    std::unique_ptr<Runtime::Program> program;
+    std::mutex vm; /**< Chrání program a všechny instance vlákna */
+
+    std::mutex queueMutex;
+    std::deque<size_t> ready{}; /**< Vlastník bere zepředu, zloděj zezadu */
+    std::atomic<size_t> depth{0}; /**< Počet položek v 'ready' */
+
+    /// Termíny časovačů vlastních instancí (jen pro vlákno samotné)
+    using Deadline = std::pair<Clock::time_point, size_t>;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<>>
+        timers{};
+
+    size_t running = 0; /**< Id právě krokované instance (pro callbacky) */
+    std::thread thread;
+  };
+
+  void Loop(size_t self);
+  void Enqueue(size_t id);
+  bool Pop(Worker& worker, size_t& id);
+  bool Steal(size_t self, size_t& id);
+
+  /**
+   * @brief Přestěhuje dosud nespuštěnou instanci do VM vlákna 'self'.
+   * @details Spuštěná instance se nestěhuje: snímek nenese tabulky, funkce
+   * ani proměnné nastavené na nil, přesun by tedy měnil chování.
+   */
+  void Adopt(size_t self, Slot& slot);
+
+  void Step(size_t self, size_t id);
+  void Notify();
+
+  Runtime::Definition definition;
+
+  /// @attention Deklarováno před 'slots', instance se ruší dříve než jejich VM
+  std::vector<std::unique_ptr<Worker>> workers{};
+  std::deque<Slot> slots{};
+
+  std::atomic<size_t> queued{0};   /**< Úlohy čekající ve frontách */
+  std::atomic<size_t> stealable{0}; /**< Z nich nepřipnuté (lze ukrást) */
+  std::atomic<size_t> inFlight{0}; /**< Právě krokované úlohy */
+  std::atomic<size_t> timed{0};    /**< Instance s čekajícím časovačem */
+  std::atomic<size_t> halted{0};   /**< Ukončené instance */
+  std::atomic<bool> inputClosed{false};
+  std::atomic<bool> stopping{false};
+  std::atomic<bool> failed{false};
+
+  std::mutex wakeMutex;
+  std::condition_variable wakeCv; /**< Probouzí nečinná vlákna */
+
+  std::mutex doneMutex;
+  std::condition_variable doneCv;
+};
+
+}  // namespace Scheduler
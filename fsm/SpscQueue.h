@@ -0,0 +1,58 @@
+/**
+ * @file   SpscQueue.h
+ * @brief  Šablonová lock-free fronta pro jednoho producenta a jednoho konzumenta.
+ * @details
+ * Kruhový buffer pevné velikosti (mocnina dvou). Producent zapisuje pouze tail_,
+ * konzument pouze head_, takže stačí acquire/release atomické operace bez zámků.
+ * @date   2025-05-11
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/**
+ * @class SpscQueue
+ * @brief Omezená fronta bez zámků pro předávání dat mezi dvěma vlákny.
+ * @tparam T        Typ položky (musí být přesunutelný a default-konstruovatelný).
+ * @tparam Capacity Počet slotů, mocnina dvou.
+ */
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0,
+                "SpscQueue capacity must be a power of two");
+
+ public:
+  /**
+   * @brief Vloží položku (volá pouze producent).
+   * @return false pokud je fronta plná.
+   */
+  bool TryPush(T&& value) {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == Capacity)
+      return false;
+    slots_[tail & (Capacity - 1)] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Vyjme nejstarší položku (volá pouze konzument).
+   * @return false pokud je fronta prázdná.
+   */
+  bool TryPop(T& value) {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    value = std::move(slots_[head & (Capacity - 1)]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  alignas(64) std::atomic<size_t> head_{0}; /**< Index čtení (konzument). */
+  alignas(64) std::atomic<size_t> tail_{0}; /**< Index zápisu (producent). */
+  std::array<T, Capacity> slots_{};         /**< Sloty kruhového bufferu. */
+};
@@ -6,12 +6,58 @@
  * Používá šablonové parametry DT (typ intervalu, default std::chrono::milliseconds)
  * a ClockT (typ hodin, default std::chrono::steady_clock). Metody tick() a tock()
  * slouží k označení začátku a konce měření, duration() vrací rozdíl.
+ * Zdroj času lze podvrhnout přes ClockSource, např. VirtualClock pro simulaci
+ * bez čekání.
  * @date   2025-05-09
  */
 #pragma once
 
+#include <atomic>
 #include <chrono>
 
+/**
+ * @class ClockSource
+ * @brief Zaměnitelný zdroj aktuálního času pro hodiny typu ClockT.
+ */
+template <class ClockT = std::chrono::steady_clock>
+class ClockSource {
+public:
+  virtual ~ClockSource() = default;
+
+  /// Aktuální čas podle tohoto zdroje
+  virtual typename ClockT::time_point now() const = 0;
+};
+
+/**
+ * @class VirtualClock
+ * @brief Simulovaný čas, který se posouvá jen explicitně.
+ * @details Začíná v epoše hodin ClockT, takže běh je deterministický.
+ */
+template <class ClockT = std::chrono::steady_clock>
+class VirtualClock : public ClockSource<ClockT> {
+  std::atomic<typename ClockT::rep> _ticks{0}; /**< Čas od epochy v ClockT::duration. */
+
+public:
+  typename ClockT::time_point now() const override {
+    return typename ClockT::time_point(typename ClockT::duration(_ticks.load()));
+  }
+
+  /**
+   * @brief Posune čas na daný okamžik (do minulosti se neposouvá).
+   */
+  void advance_to(const typename ClockT::time_point t) {
+    auto current = _ticks.load();
+    const auto target = t.time_since_epoch().count();
+    while (current < target && !_ticks.compare_exchange_weak(current, target)) {
+    }
+  }
+
+  /**
+   * @brief Posune čas o daný interval.
+   */
+  void advance(const typename ClockT::duration d) { _ticks += d.count(); }
+};
+
 /**
  * @class Timer
  * @brief Jednoduchý stopwatch pro měření doby běhu kódu.
@@ -26,28 +72,43 @@ public:
   using time_p_t = typename ClockT::time_point;
 
 private:
-  time_p_t _start = ClockT::now(); /**< Čas začátku měření. */
+  const ClockSource<ClockT>* _source = nullptr; /**< nullptr = ClockT::now() */
+  time_p_t _start = now();         /**< Čas začátku měření. */
   time_p_t _end{};                 /**< Čas ukončení měření. */
 
 public:
+  Timer() = default;
+
+  /**
+   * @brief Vytvoří stopky nad podvrženým zdrojem času.
+   * @attention Zdroj musí žít déle než stopky.
+   */
+  explicit Timer(const ClockSource<ClockT>* source)
+      : _source(source), _start(now()) {}
+
+  /**
+   * @brief Aktuální čas podle zdroje stopek.
+   */
+  time_p_t now() const { return _source ? _source->now() : ClockT::now(); }
+
   /**
    * @brief Nastaví nový startovací bod a vynuluje předchozí end.
    */
   void tick() {
     _end = time_p_t{};
-    _start = ClockT::now();
+    _start = now();
   }
 
   /**
    * @brief Označí konec měření, uloží aktuální čas do _end.
    */
   void tock() {
-    _end = ClockT::now();
+    _end = now();
   }
 
   template <class T = DT>
   auto elapsed() const {
-    return std::chrono::duration_cast<T>(ClockT::now() - _start);
+    return std::chrono::duration_cast<T>(now() - _start);
   }
 
   /**
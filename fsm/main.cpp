@@ -1,32 +1,194 @@
 #include <absl/flags/flag.h>
 #include <absl/log/absl_log.h>
 #include <absl/log/initialize.h>
+#include <absl/strings/numbers.h>
 #include <absl/strings/str_format.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <thread>
 
+#include "CompilerLib.h"
+#include "ImageLib.h"
 #include "Interpret.h"
+#include "OutputLib.h"
 #include "ParserLib.h"
 #include "external/sol.hpp"
 
-int main(const int argc, char** argv) {
-  if (argc < 2) {
+namespace {
+
+/// Volby příkazové řádky
+struct Options {
+  std::string definition;  /**< Cesta k definici automatu nebo obrazu .fsmc */
+  bool compile = false;    /**< --compile: jen zapíše obraz do 'output' */
+  std::string output;      /**< -o: cesta k obrazu */
+  bool eventLoop = false;  /**< --event-loop: běh řízený událostmi */
+  bool virtualTime = false; /**< --virtual-time: simulovaný čas bez čekání */
+  bool evaluateAll = false; /**< --evaluate-all: vyhodnotit všechny podmínky */
+  bool minimize = false;    /**< --minimize: sloučit ekvivalentní stavy */
+  bool checkGuards = false; /**< --check-guards: ověřit nativní podmínky v Lua */
+  size_t instances = 0;    /**< --instances N: počet instancí (0 = jedna bez prefixu) */
+  size_t workers = std::max(1u, std::thread::hardware_concurrency()); /**< --workers K */
+  std::string sink = "-"; /**< --sink: stdout, soubor, FIFO nebo unix:<cesta> */
+  /// --flush: kdy zapsat výstup (bez volby immediate, u --instances batch)
+  std::optional<OutputLib::FlushPolicy> flush;
+  std::chrono::microseconds flushInterval{0}; /**< --flush N: interval v µs */
+};
+
+std::optional<Options> ParseOptions(const int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    if (arg == "--compile") {
+      options.compile = true;
+    } else if (arg == "-o") {
+      if (i + 1 >= argc) {
+        ABSL_LOG(ERROR) << "-o requires an output path";
+        return std::nullopt;
+      }
+      options.output = argv[++i];
+    } else if (arg == "--event-loop") {
+      options.eventLoop = true;
+    } else if (arg == "--virtual-time") {
+      options.virtualTime = true;
+    } else if (arg == "--evaluate-all") {
+      options.evaluateAll = true;
+    } else if (arg == "--minimize") {
+      options.minimize = true;
+    } else if (arg == "--check-guards") {
+      options.checkGuards = true;
+    } else if (arg == "--instances" || arg == "--workers") {
+      size_t value = 0;
+      if (i + 1 >= argc || !absl::SimpleAtoi(argv[i + 1], &value) ||
+          value == 0) {
+        ABSL_LOG(ERROR) << arg << " requires a positive number";
+        return std::nullopt;
+      }
+      ++i;
+      (arg == "--instances" ? options.instances : options.workers) = value;
+    } else if (arg == "--sink") {
+      if (i + 1 >= argc) {
+        ABSL_LOG(ERROR) << "--sink requires a target";
+        return std::nullopt;
+      }
+      options.sink = argv[++i];
+    } else if (arg == "--flush") {
+      const auto policy =
+          i + 1 < argc ? OutputLib::ParsePolicy(argv[i + 1]) : std::nullopt;
+      if (!policy.has_value()) {
+        ABSL_LOG(ERROR) << "--flush requires immediate, batch or a positive "
+                           "interval in microseconds";
+        return std::nullopt;
+      }
+      ++i;
+      std::tie(options.flush, options.flushInterval) = policy.value();
+    } else if (arg.substr(0, 2) == "--") {
+      ABSL_LOG(ERROR) << "Unknown option " << arg;
+      return std::nullopt;
+    } else {
+      options.definition = std::string(arg);
+    }
+  }
+
+  if (options.virtualTime && options.instances > 0) {
+    ABSL_LOG(ERROR) << "--virtual-time cannot be combined with --instances";
+    return std::nullopt;
+  }
+
+  if (options.definition.empty()) {
     ABSL_LOG(ERROR) << "Requires path to valid fsm definition";
-    return 1;
+    return std::nullopt;
+  }
+
+  if (options.compile && options.output.empty()) {
+    ABSL_LOG(ERROR) << "--compile requires -o <image>";
+    return std::nullopt;
+  }
+  return options;
+}
+
+/**
+ * @brief Načte obraz .fsmc, nebo rozebere a přeloží textovou definici.
+ */
+types::CompiledAutomat LoadAutomat(const std::string& path) {
+  if (ImageLib::IsImage(path))
+    return ImageLib::Load(path);
+
+  auto parser = ParserLib::Parser();
+  const auto automat = parser.parseAutomat(path);
+  return CompilerLib::Compiler().Compile(automat);
+}
+
+/**
+ * @brief Načte definici a použije na ni volby příkazové řádky.
+ */
+types::CompiledAutomat LoadDefinition(const Options& options) {
+  auto compiled = LoadAutomat(options.definition);
+  if (options.minimize)
+    CompilerLib::Compiler().Minimize(compiled);
+  if (options.evaluateAll)
+    compiled.selection = types::Selection::EvaluateAll;
+  return compiled;
+}
+
+/**
+ * @brief Přeloží definici i její Lua chunky a zapíše obraz .fsmc.
+ */
+void CompileImage(const Options& options) {
+  auto compiled = LoadDefinition(options);
+  {
+    // Lua chunky přeloží Program, obraz pak nese jejich bytecode
+    const Runtime::Program program(
+        std::make_shared<const types::CompiledAutomat>(compiled));
+    compiled.guardBytecode = program.DumpGuards();
+    compiled.actionBytecode = program.DumpActions();
+    compiled.dispatchBytecode = program.DumpDispatchers();
   }
+  ImageLib::Write(options.output, compiled);
+}
+
+}  // namespace
+
+int main(const int argc, char** argv) {
+  const auto options = ParseOptions(argc, argv);
+  if (!options.has_value())
+    return 1;
 
   absl::InitializeLog();
 
   try {
+    if (options->compile) {
+      CompileImage(options.value());
+      return 0;
+    }
+
     Timer<> timer;
-    auto parser = ParserLib::Parser();
-    const auto automat = parser.parseAutomat(argv[1]);
-    auto interpret = Interpreter::Interpret(automat);
+    Interpreter::Interpret interpret(
+        std::make_shared<const types::CompiledAutomat>(
+            LoadDefinition(options.value())));
+    if (options->virtualTime)
+      interpret.UseVirtualTime();
+    if (options->checkGuards)
+      interpret.UseGuardCheck();
+    // Fleet vypisoval vždy po dávkách, jedna instance po každém řádku
+    const auto policy = options->flush.value_or(
+        options->instances > 0 ? OutputLib::FlushPolicy::Batch
+                               : OutputLib::FlushPolicy::Immediate);
+    interpret.UseSink(OutputLib::Sink::Open(options->sink, policy,
+                                            options->flushInterval));
     interpret.Prepare();
 
     timer.tick();
-    interpret.Execute();
+    if (options->instances > 0)
+      interpret.ExecuteFleet(options->instances, options->workers);
+    else if (options->eventLoop)
+      interpret.ExecuteEvents();
+    else
+      interpret.Execute();
     timer.tock();
 
     std::cerr << "Execute took " << timer.duration<std::chrono::seconds>().count() << "s." << std::endl;
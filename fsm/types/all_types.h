@@ -13,3 +13,4 @@
 #include "states.h"       /**< Definice State a StateGroup */  
 #include "transitions.h"  /**< Definice Transition a TransitionGroup */  
 #include "variables.h"    /**< Definice Variable a VariableGroup */
+#include "compiled.h"     /**< Definice Edge a CompiledAutomat */
@@ -0,0 +1,384 @@
+/**
+ * @file   compiled.h
+ * @brief  Definuje přeloženou (indexovanou) reprezentaci automatu pro běh.
+ * @details
+ * Stavy a vstupní signály dostanou husté celočíselné identifikátory a výstupní
+ * přechody každého stavu leží souvisle v jednom poli (CSR). Interpret pak krokuje
+ * automat indexováním polí místo hledání podle jmen.
+ * @date   2025-05-11
+ */
+
+#pragma once
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/strings/match.h>
+#include <absl/strings/string_view.h>
+#include <absl/types/span.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "variables.h"
+
+namespace types {
+
+/// Identifikátor, který neodkazuje na žádný stav ani signál.
+inline constexpr uint32_t NoId = std::numeric_limits<uint32_t>::max();
+
+/// Způsob výběru přechodu z intervalu kandidátů
+enum class Selection : uint8_t {
+  FirstMatch,  /**< Vyhodnocuje podmínky v pořadí do první platné */
+  EvaluateAll  /**< Vyhodnotí všechny (podmínky s vedlejšími efekty) */
+};
+
+/// Deklarovaný typ vstupního signálu
+enum class SignalType : uint8_t {
+  Text,   /**< Bez typu, hodnota zůstává řetězcem */
+  Int,    /**< int64_t */
+  Double, /**< double (i pro deklaraci float) */
+  Bool    /**< true/false nebo 1/0 */
+};
+
+/**
+ * @brief Převede jméno typu z deklarace vstupu ("int in1") na SignalType.
+ * @return Typ nebo nullopt pro neznámé jméno.
+ */
+inline std::optional<SignalType> SignalTypeOf(const absl::string_view name) {
+  if (name.empty() || absl::EqualsIgnoreCase(name, "string"))
+    return SignalType::Text;
+  if (absl::EqualsIgnoreCase(name, "int"))
+    return SignalType::Int;
+  if (absl::EqualsIgnoreCase(name, "double") ||
+      absl::EqualsIgnoreCase(name, "float"))
+    return SignalType::Double;
+  if (absl::EqualsIgnoreCase(name, "bool"))
+    return SignalType::Bool;
+  return std::nullopt;
+}
+
+/// Hodnoty vstupů zadané jedním řádkem (INPUT: a=1; b=2), po id signálu
+using InputFrame = std::vector<std::pair<uint32_t, TypedValue>>;
+
+/**
+ * @struct Edge
+ * @brief Jeden přechod řádku v přeložené podobě.
+ * @details Cíl přechodu se liší mezi stavy, které řádek sdílejí, a leží
+ * v CompiledAutomat::targets.
+ */
+struct Edge {
+  uint32_t signal = NoId;  /**< Id vstupního signálu nebo NoId. */
+  int delay = 0;           /**< Zpoždění v ms, 0 pokud přechod nečeká. */
+  bool guarded = false;    /**< Přechod má netriviální podmínku. */
+
+  [[nodiscard]] bool HasInput() const { return signal != NoId; }
+  [[nodiscard]] bool HasDelay() const { return delay != 0; }
+};
+
+// Přechody řádku se procházejí souvisle, Edge musí zůstat malé POD
+static_assert(std::is_trivially_copyable_v<Edge> && sizeof(Edge) <= 12);
+
+/**
+ * @struct EdgeRange
+ * @brief Polootevřený interval [begin, end) v poli CompiledAutomat::order.
+ */
+struct EdgeRange {
+  uint32_t begin = 0;
+  uint32_t end = 0;
+
+  [[nodiscard]] bool empty() const { return begin == end; }
+  [[nodiscard]] uint32_t size() const { return end - begin; }
+};
+
+/**
+ * @struct InputBucket
+ * @brief Přechody jednoho stavu čekající na stejný vstupní signál.
+ */
+struct InputBucket {
+  uint32_t signal = NoId; /**< Id signálu. */
+  EdgeRange untimed{};    /**< Přechody bez zpoždění v pořadí definice. */
+  EdgeRange timed{};      /**< Přechody se zpožděním seřazené podle delay. */
+};
+
+/**
+ * @struct StatePlan
+ * @brief Předpočítaný plán výběru přechodu pro jeden řádek.
+ * @details
+ * Plán vzniká jednou při překladu, takže Execute při každém kroku nemusí
+ * přechody třídit, filtrovat ani skládat výpis REQUEST_INPUTS.
+ */
+struct StatePlan {
+  EdgeRange free{};    /**< Přechody bez vstupu a bez zpoždění. */
+  EdgeRange timers{};  /**< Přechody jen se zpožděním, seřazené podle delay. */
+  EdgeRange buckets{}; /**< Interval v poli buckets seřazený podle signálu. */
+  bool inputs = false;      /**< Stav má vstupní přechod bez zpoždění. */
+  bool timedInputs = false; /**< Stav má vstupní přechod se zpožděním. */
+  std::string requestInputs; /**< Předrenderovaný řádek REQUEST_INPUTS. */
+};
+
+/**
+ * @struct CompiledAutomat
+ * @brief Automat s hustými id stavů a signálů a přechody ve sdílených řádcích.
+ * @details
+ * Řádek je posloupnost přechodů (vstup, zpoždění, podmínka) v pořadí
+ * vyhodnocení; stavy se stejnou posloupností sdílejí jeden řádek i jeho plán
+ * výběru a liší se jen cíli. Přechody řádku @c r jsou @c edges[rowOffsets[r]]
+ * až @c edges[rowOffsets[r + 1] - 1], cíle stavu @c s leží od
+ * @c targets[offsets[s]] ve stejném pořadí. Stav s id 0 je počáteční stav.
+ * Struktura je po překladu neměnná, takže ji mohou sdílet všechny instance
+ * a vlákna, která automat spouštějí.
+ */
+struct CompiledAutomat {
+  std::vector<std::string> stateNames;                 /**< Id -> jméno stavu */
+  absl::flat_hash_map<std::string, uint32_t> stateIds; /**< Jméno -> id */
+  std::vector<std::string> signalNames; /**< Id -> jméno vstupu */
+  absl::flat_hash_map<std::string, uint32_t> signalIds; /**< Jméno -> id */
+  std::vector<SignalType> signalTypes;  /**< Id -> deklarovaný typ vstupu */
+
+  std::vector<uint32_t> rows;        /**< Id stavu -> id řádku */
+  std::vector<uint32_t> offsets;     /**< Začátky cílů stavů, velikost stavů + 1 */
+  std::vector<uint32_t> targets;     /**< Cíle přechodů po stavech */
+  std::vector<uint32_t> transitions; /**< Id původních Transition (diagnostika) */
+
+  std::vector<uint32_t> rowOffsets; /**< Začátky řádků, velikost řádků + 1 */
+  std::vector<Edge> edges;          /**< Přechody seřazené podle řádku */
+
+  std::vector<StatePlan> plans;      /**< Plán výběru pro každý řádek */
+  std::vector<uint32_t> order;       /**< Indexy do edges seskupené podle plánů */
+  std::vector<InputBucket> buckets;  /**< Vstupní skupiny všech řádků */
+
+  std::vector<std::string> guardSources;  /**< Lua podmínka hrany ("" = žádná) */
+  std::vector<std::string> actionSources; /**< Lua akce stavu */
+  std::vector<std::string> outputNames;   /**< Id -> jméno výstupu */
+  absl::flat_hash_map<std::string, uint32_t> outputIds; /**< Jméno -> id */
+  std::vector<Variable> variables; /**< Proměnné s počátečními hodnotami */
+  /// Jméno -> id proměnné (index do variables), viz IndexVariables
+  absl::flat_hash_map<std::string, uint32_t> variableIds;
+  /// Počáteční hodnoty převedené podle typu, po id proměnné
+  std::vector<TypedValue> variableValues;
+  Selection selection = Selection::FirstMatch; /**< Výběr přechodu */
+
+  /// Předpřeložený Lua bytecode (jen z obrazu .fsmc, jinak prázdné)
+  std::vector<std::string> guardBytecode;  /**< Po hranách ("" = žádná) */
+  std::vector<std::string> actionBytecode; /**< Po stavech */
+  /// Výběrové funkce po začátcích intervalů v order ("" = žádná)
+  std::vector<std::string> dispatchBytecode;
+
+  [[nodiscard]] size_t StateCount() const { return stateNames.size(); }
+  [[nodiscard]] size_t SignalCount() const { return signalNames.size(); }
+
+  [[nodiscard]] size_t RowCount() const { return plans.size(); }
+
+  /**
+   * @brief Vrací index prvního přechodu stavu v poli edges.
+   */
+  [[nodiscard]] uint32_t FirstEdge(const uint32_t state) const {
+    return rowOffsets[rows[state]];
+  }
+
+  /**
+   * @brief Vrací plán výběru stavu (plán jeho řádku).
+   */
+  [[nodiscard]] const StatePlan& PlanOf(const uint32_t state) const {
+    return plans[rows[state]];
+  }
+
+  /**
+   * @brief Vrací všechny výstupní přechody stavu (přechody jeho řádku).
+   */
+  [[nodiscard]] absl::Span<const Edge> EdgesOf(const uint32_t state) const {
+    const auto row = rows[state];
+    return absl::MakeConstSpan(edges.data() + rowOffsets[row],
+                               rowOffsets[row + 1] - rowOffsets[row]);
+  }
+
+  /**
+   * @brief Vrací cíle přechodů stavu v pořadí EdgesOf.
+   */
+  [[nodiscard]] absl::Span<const uint32_t> TargetsOf(
+      const uint32_t state) const {
+    return absl::MakeConstSpan(targets.data() + offsets[state],
+                               offsets[state + 1] - offsets[state]);
+  }
+
+  /**
+   * @brief Vrací cíl přechodu edge (index do edges) ze stavu state.
+   */
+  [[nodiscard]] uint32_t Target(const uint32_t state,
+                                const uint32_t edge) const {
+    return targets[offsets[state] + edge - FirstEdge(state)];
+  }
+
+  /**
+   * @brief Vrací id původního Transition přechodu edge ze stavu state.
+   */
+  [[nodiscard]] uint32_t TransitionOf(const uint32_t state,
+                                      const uint32_t edge) const {
+    return transitions[offsets[state] + edge - FirstEdge(state)];
+  }
+
+  /**
+   * @brief Vrací indexy přechodů (do edges) v daném intervalu pole order.
+   */
+  [[nodiscard]] absl::Span<const uint32_t> Order(const EdgeRange range) const {
+    return absl::MakeConstSpan(order.data() + range.begin, range.size());
+  }
+
+  /**
+   * @brief Projde interval časovačů po skupinách se stejným zpožděním.
+   * @param f Volá se s první hranou skupiny a intervalem skupiny v order.
+   */
+  template <typename F>
+  void ForEachDelayGroup(const EdgeRange range, F&& f) const {
+    const auto ids = Order(range);
+    for (uint32_t i = 0; i < ids.size();) {
+      const auto delay = edges[ids[i]].delay;
+      auto j = i;
+      while (j < ids.size() && edges[ids[j]].delay == delay) ++j;
+      f(edges[ids[i]], EdgeRange{range.begin + i, range.begin + j});
+      i = j;
+    }
+  }
+
+  /**
+   * @brief Projde všechny intervaly, nad kterými se vybírá přechod (volné
+   * přechody, vstupní skupiny a skupiny časovačů).
+   */
+  template <typename F>
+  void ForEachSelectionRange(F&& f) const {
+    const auto group = [&f](const Edge&, const EdgeRange range) { f(range); };
+    for (const auto& plan : plans) {
+      f(plan.free);
+      ForEachDelayGroup(plan.timers, group);
+    }
+    for (const auto& bucket : buckets) {
+      f(bucket.untimed);
+      ForEachDelayGroup(bucket.timed, group);
+    }
+  }
+
+  /**
+   * @brief Najde vstupní skupinu stavu pro daný signál.
+   * @return Ukazatel na skupinu nebo nullptr, pokud stav na signál nečeká.
+   */
+  [[nodiscard]] const InputBucket* FindBucket(const StatePlan& plan,
+                                              const uint32_t signal) const {
+    const auto first = buckets.begin() + plan.buckets.begin;
+    const auto last = buckets.begin() + plan.buckets.end;
+    const auto it = std::lower_bound(
+        first, last, signal, [](const InputBucket& bucket, const uint32_t id) {
+          return bucket.signal < id;
+        });
+    return it != last && it->signal == signal ? &*it : nullptr;
+  }
+
+  /**
+   * @brief Přestaví variableIds a variableValues podle pole variables.
+   * @details Volá se po každé změně variables (překlad, načtení obrazu).
+   */
+  void IndexVariables() {
+    variableIds.clear();
+    variableValues.clear();
+    variableValues.reserve(variables.size());
+    for (const auto& variable : variables) {
+      variableIds.emplace(variable.Name,
+                          static_cast<uint32_t>(variableValues.size()));
+      variableValues.push_back(variable.Typed());
+    }
+  }
+
+  /**
+   * @brief Převede jméno proměnné na id.
+   * @return Id proměnné nebo NoId.
+   */
+  [[nodiscard]] uint32_t VariableId(const absl::string_view name) const {
+    const auto it = variableIds.find(name);
+    return it == variableIds.end() ? NoId : it->second;
+  }
+
+  /**
+   * @brief Převede jméno stavu na id.
+   * @return Id stavu nebo NoId.
+   */
+  [[nodiscard]] uint32_t StateId(const absl::string_view name) const {
+    const auto it = stateIds.find(name);
+    return it == stateIds.end() ? NoId : it->second;
+  }
+
+  /**
+   * @brief Převede jméno vstupního signálu na id.
+   * @return Id signálu nebo NoId.
+   */
+  [[nodiscard]] uint32_t SignalId(const absl::string_view name) const {
+    const auto it = signalIds.find(name);
+    return it == signalIds.end() ? NoId : it->second;
+  }
+
+  /**
+   * @brief Převede text hodnoty vstupu podle deklarovaného typu signálu.
+   * @details Vstup se převádí jednou při čtení, podmínky pak dostávají
+   * číslo místo řetězce a tonumber() nic nepřevádí.
+   * @return Hodnota nebo nullopt, pokud text typu neodpovídá.
+   */
+  [[nodiscard]] std::optional<TypedValue> SignalValue(
+      const uint32_t signal, const absl::string_view text) const {
+    const std::string_view digits(text.data(), text.size());
+    switch (signalTypes[signal]) {
+      case SignalType::Text:
+        return TypedValue{std::string(text)};
+      case SignalType::Int:
+        if (const auto v = Utils::StringToNumeric<int64_t>(digits);
+            v.has_value())
+          return TypedValue{v.value()};
+        return std::nullopt;
+      case SignalType::Double:
+        if (const auto v = Utils::StringToNumeric<double>(digits);
+            v.has_value())
+          return TypedValue{v.value()};
+        return std::nullopt;
+      case SignalType::Bool:
+        if (text == "1" || absl::EqualsIgnoreCase(text, "true"))
+          return TypedValue{true};
+        if (text == "0" || absl::EqualsIgnoreCase(text, "false"))
+          return TypedValue{false};
+        return std::nullopt;
+    }
+    return std::nullopt;
+  }
+
+  /**
+   * @brief Hodnota vstupu před prvním zadáním: nulová hodnota jeho typu.
+   * @details Netypovaný vstup začíná prázdným řetězcem jako dřív; číselný
+   * a logický vstup tak lze v podmínce porovnávat hned od začátku.
+   */
+  [[nodiscard]] TypedValue SignalDefault(const uint32_t signal) const {
+    switch (signalTypes[signal]) {
+      case SignalType::Int:
+        return TypedValue{int64_t{0}};
+      case SignalType::Double:
+        return TypedValue{0.0};
+      case SignalType::Bool:
+        return TypedValue{false};
+      case SignalType::Text:
+        break;
+    }
+    return TypedValue{std::string()};
+  }
+
+  /**
+   * @brief Převede jméno výstupu na id.
+   * @return Id výstupu nebo NoId.
+   */
+  [[nodiscard]] uint32_t OutputId(const absl::string_view name) const {
+    const auto it = outputIds.find(name);
+    return it == outputIds.end() ? NoId : it->second;
+  }
+};
+
+}  // namespace types
@@ -1,4 +1,7 @@
 #pragma once
+#include <absl/container/flat_hash_map.h>
+#include <absl/strings/string_view.h>
+
 #include <range/v3/view.hpp>
 #include <string>
 #include <vector>
@@ -45,20 +48,26 @@ template <typename T = std::string>
 struct StateGroup {
  private:
   std::vector<State<T>> states;
-  std::vector<std::shared_ptr<State<T>>> secondary;
+  /// Jméno -> pozice ve 'states' (při duplicitě první výskyt)
+  absl::flat_hash_map<std::string, size_t> index;
+
+  void Index(const size_t at) { index.try_emplace(states[at].Name, at); }
 
  public:
   StateGroup() = default;
   explicit StateGroup(std::vector<State<T>> states)
-      : states(std::move(states)) {}
+      : states(std::move(states)) {
+    for (size_t i = 0; i < this->states.size(); ++i) Index(i);
+  }
   StateGroup(StateGroup &&group) noexcept
-      : states(std::move(group.states)) {}
+      : states(std::move(group.states)), index(std::move(group.index)) {}
   StateGroup(const StateGroup &group) noexcept
-      : states(group.states) {}
+      : states(group.states), index(group.index) {}
 
   void swap(StateGroup& other) noexcept{
     using std::swap;
     swap(states, other.states);
+    swap(index, other.index);
   }
 
   StateGroup &operator=(const StateGroup &group) {
@@ -100,11 +109,13 @@ struct StateGroup {
     return StateGroup<ResultT>(new_states);
   }
 
-  StateGroup Find(std::string name) const {
-    auto it = states | ranges::views::filter([name](const State<T> &state) {
-                return state.Name == name;
-              });
-    return StateGroup(it | ranges::to<std::vector<State<T>>>());
+  /**
+   * @brief Najde stav podle jména v konstantním čase bez kopie.
+   * @return Ukazatel na stav nebo nullptr; platí do dalšího Add.
+   */
+  [[nodiscard]] const State<T> *Find(const absl::string_view name) const {
+    const auto it = index.find(name);
+    return it == index.end() ? nullptr : &states[it->second];
   }
 
   [[nodiscard]] State<T> First() const {
@@ -126,14 +137,14 @@ struct StateGroup {
 
   StateGroup& Add(const State<T> &state) {
     states.emplace_back(state);
+    Index(states.size() - 1);
     return *this;
   }
 
   // StateGroup& AddShared()
 
   StateGroup &operator<<(const State<T> &state) {
-    states.emplace_back(state);
-    return *this;
+    return Add(state);
   }
 
   friend std::ostream &operator<<(std::ostream &os, const StateGroup &state) {
@@ -142,8 +153,9 @@ struct StateGroup {
     }
     return os;
   }
-  [[nodiscard]] auto begin() { return states.begin(); }
-  [[nodiscard]] auto end() { return states.end(); }
+  /// Jen pro čtení: změna jména by rozbila index pro Find
+  [[nodiscard]] auto begin() const { return states.cbegin(); }
+  [[nodiscard]] auto end() const { return states.cend(); }
 
   [[nodiscard]] auto cbegin() const { return states.cbegin(); }
   [[nodiscard]] auto cend() const { return states.cend(); }
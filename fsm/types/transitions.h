@@ -4,7 +4,9 @@
  * @author xhlochm00 Michal Hloch
  * @author xzelni06 Robert Zelníček
  * @details
- * Struktura Transition uchovává informace o jednotlivém přechodu mezi stavy.
+ * Struktura Transition uchovává textový popis jednotlivého přechodu z definice;
+ * běhová podoba přechodu je kompaktní Edge v compiled.h a text se dál používá
+ * jen pro diagnostiku a export.
  * TransitionGroup slouží ke kolekci přechodů a poskytuje metody pro filtrování,
  * skupinování, transformace a manipulaci s množinou přechodů.
  * @date   2025-05-11
@@ -42,10 +44,8 @@ class Transition {
   std::string to{};
   std::string input{};
   std::string condition{};
-  sol::protected_function function{};
-  bool hasCondition = false;
   std::string delay{};
-  int delayInt{};
+  int priority{}; /**< Menší číslo se zkouší dříve, shoda = pořadí definice */
   unsigned Id{};
 
   static std::atomic<unsigned> counter;
@@ -68,13 +68,9 @@ class Transition {
         to(std::move(other.to)),
         input(std::move(other.input)),
         condition(std::move(other.condition)),
-        function(std::move(other.function)),
-        hasCondition(other.hasCondition),
         delay(std::move(other.delay)),
-        delayInt(other.delayInt) {
-    hasCondition = function.valid();
-    Id = other.Id;
-  }
+        priority(other.priority),
+        Id(other.Id) {}
 
   Transition() = default;
 
@@ -86,12 +82,10 @@ class Transition {
       from = std::move(other.from);
       to = std::move(other.to);
       condition = std::move(other.condition);
-      function = std::move(other.function);
       input = std::move(other.input);
       delay = std::move(other.delay);
-      delayInt = other.delayInt;
+      priority = other.priority;
       Id = other.Id;
-      hasCondition = function.valid();
     }
     return *this;
   }
@@ -119,17 +113,15 @@ class Transition {
       return false;
     if (delay != transition.delay)
       return false;
-    if (hasCondition != transition.hasCondition)
-      return false;
     return true;
   }
   bool operator!=(const Transition& transition) const {
     return !(*this == transition);
   }
   bool operator<(const Transition& other) const {
-    return std::tie(from, to, input, condition, delay, hasCondition) <
+    return std::tie(from, to, input, condition, delay) <
            std::tie(other.from, other.to, other.input, other.condition,
-                    other.delay, other.hasCondition);
+                    other.delay);
   }
 
   std::string ToString() const {
@@ -144,11 +136,9 @@ class Transition {
   friend std::ostream& operator<<(std::ostream& os,
                                   const Transition& transition) {
     os << absl::StrFormat(
-        "%d: {%s -> %s on input: <%s> if condition: <%s|%v> after delay: "
-        "<%s|%v>} ",
+        "%d: {%s -> %s on input: <%s> if condition: <%s> after delay: <%s>} ",
         transition.Id, transition.from, transition.to, transition.input,
-        transition.condition, transition.function.valid(), transition.delay,
-        transition.delayInt);
+        transition.condition, transition.delay);
     return os;
   }
 };
@@ -265,19 +255,23 @@ class TransitionGroup {
 
   [[nodiscard]] TransitionGroup WhereNone() const {
     return Where([](const auto& tr) {
-      return !tr.hasCondition && tr.delay.empty() && tr.input.empty();
+      return tr.condition.empty() && tr.delay.empty() && tr.input.empty();
     });
   }
   [[nodiscard]] std::optional<Transition> SmallestTimer() const {
     const auto min = WhereTimer<>().First();
     if (!min.has_value())
       return std::nullopt;
-    auto min_v = min.value();
+    // Zpoždění dané jménem proměnné se zde neřeší, porovnávají se čísla
+    const auto delayOf = [](const Transition& tr) {
+      return Utils::StringToNumeric<int>(tr.delay).value_or(0);
+    };
+    const Transition* min_v = &min.value();
     for (auto& [id, tr] : primary) {
-      if (tr.delayInt < min_v.delayInt)
-        min_v = tr;
+      if (!tr.delay.empty() && delayOf(tr) < delayOf(*min_v))
+        min_v = &tr;
     }
-    return min_v;
+    return *min_v;
   }
 
   [[nodiscard]] bool Contains(const Transition& tr) const {
@@ -308,7 +302,7 @@ class TransitionGroup {
     const auto second = ranges::size(other.primary | ranges::views::values);
     final.reserve(std::min(first, second));
 
-    auto small = first > second ? other.primary : primary;
+    const auto& small = first > second ? other.primary : primary;
 
     for (const auto& [fst, snd] : small) {
       if (other.primary.contains(fst) && primary.contains(fst))
@@ -319,7 +313,6 @@ class TransitionGroup {
   }
 
   [[nodiscard]] TransitionGroup Merge(const TransitionGroup& other) const {
-    auto large = Size() > other.Size() ? primary : other.primary;
     auto final = TransitionGroup{};
     final.primary = primary;
 
@@ -5,23 +5,34 @@
  * @author xzelni06 Robert Zelníček
  * @details
  * Struktura Variable uchovává informace o typu, názvu a hodnotě proměnné.
- * VariableGroup poskytuje kolekci těchto proměnných a metody pro vkládání a vyhledávání.
+ * VariableGroup poskytuje kolekci těchto proměnných a metody pro vkládání
+ * a vyhledávání podle jména v konstantním čase. Typed() převede textovou
+ * hodnotu podle deklarovaného typu jednou při překladu.
  * @date   2025-05-09
  */
 
 #pragma once
 
-#include <absl/container/btree_set.h>
+#include <absl/container/flat_hash_map.h>
+#include <absl/strings/match.h>
 #include <absl/strings/str_format.h>
+#include <absl/strings/string_view.h>
 
+#include <cstdint>
 #include <optional>
 #include <string>
 #include <utility>
+#include <variant>
+#include <vector>
 
 #include "../Utils.h"
 
 namespace types {
 
+/// Hodnota proměnné podle typu (monostate = typ nebo hodnotu nelze převést)
+using TypedValue =
+    std::variant<std::monostate, bool, int64_t, double, std::string>;
+
 /**
  * @class Variable
  * @brief Uchovává informace o jedné proměnné.
@@ -69,6 +80,30 @@ class Variable {
     }
   }
 
+  /**
+   * @brief Převede hodnotu podle deklarovaného typu.
+   * @details int je celé číslo, float se zaokrouhlí na přesnost float,
+   * double, který nejde převést, zůstane řetězcem; bool a string zůstávají
+   * řetězcem jako dosud v Lua prostředí.
+   */
+  [[nodiscard]] TypedValue Typed() const {
+    if (absl::EqualsIgnoreCase(Type, "int")) {
+      if (const auto v = Utils::StringToNumeric<int>(Value); v.has_value())
+        return static_cast<int64_t>(v.value());
+    } else if (absl::EqualsIgnoreCase(Type, "float")) {
+      if (const auto v = Utils::StringToNumeric<float>(Value); v.has_value())
+        return static_cast<double>(v.value());
+    } else if (absl::EqualsIgnoreCase(Type, "double")) {
+      if (const auto v = Utils::StringToNumeric<double>(Value); v.has_value())
+        return v.value();
+      return Value;
+    } else if (absl::EqualsIgnoreCase(Type, "bool") ||
+               absl::EqualsIgnoreCase(Type, "string")) {
+      return Value;
+    }
+    return std::monostate{};
+  }
+
   /**
    * @brief Vrací tuple {Type, Name, Value}.
    */
@@ -98,10 +133,11 @@ class Variable {
 
 /**
  * @class VariableGroup
- * @brief Kolekce proměnných s možností vkládání a vyhledávání.
+ * @brief Kolekce proměnných v pořadí deklarace s indexem podle jména.
  */
 class VariableGroup {
-  absl::btree_set<Variable> vars_; /**< Množina proměnných. */
+  std::vector<Variable> vars_; /**< Proměnné po id (pořadí deklarace). */
+  absl::flat_hash_map<std::string, uint32_t> ids_; /**< Jméno -> id. */
 
  public:
   /**
@@ -112,14 +148,18 @@ class VariableGroup {
   /**
    * @brief Vrací všechny proměnné.
    */
-  [[nodiscard]] absl::btree_set<Variable> Get() const { return vars_; }
+  [[nodiscard]] const std::vector<Variable> &Get() const { return vars_; }
 
-  auto begin() { return vars_.begin(); }
-  auto end() { return vars_.end(); }
+  /// Jen pro čtení: změna jména by rozbila index pro Find; měnit přes Insert
+  auto begin() const { return vars_.cbegin(); }
+  auto end() const { return vars_.cend(); }
   auto size() const { return vars_.size(); }
 
+  /**
+   * @brief Přidá proměnnou; opakovaná deklarace jména přepíše předchozí.
+   */
   VariableGroup Add(Variable &&var) {
-    vars_.insert(std::move(var));
+    Insert(std::move(var));
     return *this;
   }
 
@@ -127,17 +167,12 @@ class VariableGroup {
    * @brief Přidá proměnnou do skupiny.
    */
   VariableGroup &operator<<(Variable &&var) {
-    vars_.insert(std::move(var));
-    return *this;
-  }
-
-  VariableGroup &operator<<(const Variable &&var) {
-    vars_.insert(var);
+    Insert(std::move(var));
     return *this;
   }
 
   VariableGroup &operator<<(const Variable &var) {
-    vars_.insert(var);
+    Insert(Variable(var));
     return *this;
   }
 
@@ -153,17 +188,26 @@ class VariableGroup {
   /**
    * @brief Hledá proměnnou podle jména.
    * @param name Jméno proměnné.
-   * @return Optional s proměnnou nebo nullopt.
+   * @return Ukazatel na proměnnou nebo nullptr.
    */
-  [[nodiscard]] std::optional<Variable> Find(const std::string &name) const {
-    for (const auto &v : vars_) {
-      if (v.Name == name)
-        return v;
-    }
-    return std::nullopt;
+  [[nodiscard]] const Variable *Find(const absl::string_view name) const {
+    const auto it = ids_.find(name);
+    return it == ids_.end() ? nullptr : &vars_[it->second];
   }
-  [[nodiscard]] bool Contains(const Variable &name) const {
-    return vars_.contains(name);
+  [[nodiscard]] bool Contains(const Variable &var) const {
+    const auto *found = Find(var.Name);
+    return found != nullptr && found->Type == var.Type &&
+           found->Value == var.Value;
+  }
+
+ private:
+  void Insert(Variable &&var) {
+    const auto [it, added] =
+        ids_.try_emplace(var.Name, static_cast<uint32_t>(vars_.size()));
+    if (added)
+      vars_.emplace_back(std::move(var));
+    else
+      vars_[it->second] = std::move(var);
   }
 };
 
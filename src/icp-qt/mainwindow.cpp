@@ -319,7 +319,10 @@ void MainWindow::onImportClicked() {
 
   // Inputs
   ui->automatInputs->clear();
-  for (const auto& inName : parsed.inputs) {
+  for (size_t i = 0; i < parsed.inputs.size(); ++i) {
+    // Typed declarations ("int in1") round-trip through the editor
+    const auto& type = parsed.inputTypes[i];
+    const auto inName = type.empty() ? parsed.inputs[i] : type + " " + parsed.inputs[i];
     ui->automatInputs->addItem(QString::fromStdString(inName));
   }
 